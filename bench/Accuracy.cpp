@@ -0,0 +1,822 @@
+/*
+ * Accuracy.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* Compares the faster ways of tracing against a reference on a set of
+   scene files:
+
+     elfelli-accuracy [--engine NAME]... [--max-field-error E]
+                      [--max-distance D] [--grid N] SCENE|DIR...
+
+   The reference evaluates the field with force_at() and follows it
+   with the Dormand-Prince integrator at a tolerance so tight that its
+   own error does not matter.  Every engine changes one thing: the
+   field evaluation, or the integrator with the exact field.  The
+   "baseline" engine is the original tracer, force_at() and Euler
+   steps, so the reference is checked against it as well.
+
+   For each scene and engine it checks three things:
+
+   - The RMS relative error of the field at random points
+     (Simulation::field_error()) against the error the engine is
+     expected to make, see the engines below.
+
+   - Every line followed (Simulation::follow()) from starts on a grid
+     over the scene against the line of the reference from the same
+     start, over their first ARC pixels: no point of either may be
+     farther from the other line than the bound of the line allows,
+     see apart().  The bound is the error the engine is expected to
+     make along the line, times how much the line spreads an error
+     made on it, see line_bounds(), plus the RESOLUTION of the points.
+     Lines on which the smallest error leads somewhere else entirely,
+     past a saddle point or the edge of a body, cannot be held to any
+     bound and are left out; the table shows how many are checked.
+
+   - The whole drawing run() makes of the scene against that of the
+     reference, by the distance of every point of either from the
+     nearest point of the other, within the view.  Its lines start
+     next to the bodies rather than on the grid, so they are held to
+     the bounds of the lines above as a whole: at the 90th, 95th and
+     99th percentile the distances must stay within the bounds at the
+     same percentile, and no more than OUTLIERS of the points may be
+     farther off than the largest bound.
+
+   The table shows the 95th percentile and the maximum of the
+   distances of the lines, and the 99th percentile and the maximum of
+   those of the drawing, each with the most it comes to of its bound.
+   --max-field-error and --max-distance replace the bounds of all
+   engines. */
+
+#include "Simulation.h"
+#include "XmlLoader.h"
+#include "FieldGrid.h"
+#include "SplitFieldGrid.h"
+#include "Integrator.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace Elfelli;
+
+namespace
+{
+
+const unsigned int FIELD_SAMPLES = 20000;
+const float MARGIN = 50;
+
+/* Length of the lines that is compared.  Two lines that stay close
+   need not be at the same point after the same arc length, so each
+   point is compared with the other line up to SLIP pixels of arc
+   length before and after it, and the lines are followed that far
+   beyond ARC.  MAX_STEPS is the most steps that takes. */
+const float ARC = 400;
+const float SLIP = 2*EulerIntegrator::STEP;
+const unsigned int MAX_STEPS = (ARC + SLIP)/RK45Integrator::MIN_STEP + 1;
+
+/* Two lines into the same body or plate reach it at slightly
+   different points and end a step or two apart; lengths that differ
+   by less do not count. */
+const float END_SLACK = 4*EulerIntegrator::STEP;
+
+/* Tolerance of the reference integrator */
+const float REFERENCE_TOLERANCE = 1e-5;
+
+/* Relative error of evaluating the same sum in floats in another
+   order, with another kernel: a hundred roundings. */
+const float ROUNDING = 100*FLT_EPSILON;
+
+/* How far the points of a line may be off the curve they stand for:
+   the sagitta add_curve() in Simulation.cpp allows between long steps,
+   on either of the two lines compared. */
+const float RESOLUTION = 2*0.25f;
+
+/* Share of the points of a drawing that may be farther off the
+   reference drawing than any line is allowed to be */
+const float OUTLIERS = 0.01;
+
+/* Cells per tile edge of the grids next to their exact or near radius,
+   see FieldGrid::build() and SplitFieldGrid::build() */
+const float FINEST_CELLS = 16;
+
+/* What an engine is expected to get wrong with the given options: the
+   relative field error, and the error of the lines on top of that of
+   the field per unit of arc length and per radian they turn. */
+struct Expected
+{
+  float field;
+  float drift;
+  float bend;
+};
+
+struct Engine
+{
+  const char *name;
+  const char *description;
+  void (*setup)(Simulation& sim, TraceOptions& opts);
+  Expected (*expected)(const TraceOptions& opts);
+};
+
+void setup_simd(Simulation&, TraceOptions& opts)
+{
+  opts.vectorize = true;
+}
+
+Expected expected_simd(const TraceOptions&)
+{
+  Expected e = {ROUNDING, 0, 0};
+  return e;
+}
+
+void setup_barnes_hut(Simulation&, TraceOptions& opts)
+{
+  opts.barnes_hut = true;
+}
+
+/* A cell of size s has its charges within s/sqrt(2) of its centre;
+   after the dipole term the expansion of the field of a cell at
+   distance d is off by about 3/2 (s/sqrt(2)/d)^2 < 3/4 theta^2 of it. */
+Expected expected_barnes_hut(const TraceOptions& opts)
+{
+  Expected e = {0.75f*opts.theta*opts.theta, 0, 0};
+  return e;
+}
+
+void setup_field_grid(Simulation&, TraceOptions& opts)
+{
+  opts.vectorize = true;
+  opts.field_grid = true;
+}
+
+/* Bilinear interpolation with cells of size h is off by about
+   h^2/8 times the second derivative, which for the field of a charge
+   at distance r is 6/r^2 of it in both directions: 3/2 (h/r)^2. */
+Expected grid_error(float tile_size, float radius)
+{
+  float h = tile_size/FINEST_CELLS;
+  Expected e = {1.5f*(h/radius)*(h/radius), 0, 0};
+  return e;
+}
+
+Expected expected_field_grid(const TraceOptions& opts)
+{
+  return grid_error(FieldGrid::TILE_SIZE, opts.exact_radius);
+}
+
+/* The first object counts as being edited, see begin_body_edit(). */
+void setup_edit(Simulation& sim, TraceOptions& opts)
+{
+  opts.vectorize = true;
+  sim.set_options(opts);
+  if(!sim.get_bodies().empty())
+    sim.begin_body_edit(0);
+  else if(!sim.get_plates().empty())
+    sim.begin_plate_edit(0);
+}
+
+Expected expected_edit(const TraceOptions& opts)
+{
+  return grid_error(SplitFieldGrid::TILE_SIZE, opts.exact_radius);
+}
+
+/* The integrator as it is used by default */
+void setup_rk45(Simulation&, TraceOptions& opts)
+{
+  opts.tolerance = TraceOptions().tolerance;
+}
+
+/* The tolerance is the error per unit of arc length. */
+Expected expected_rk45(const TraceOptions& opts)
+{
+  Expected e = {0, opts.tolerance, 0};
+  return e;
+}
+
+void setup_baseline(Simulation&, TraceOptions& opts)
+{
+  opts.integrator = INTEGRATOR_EULER;
+}
+
+/* A step of length h along a curve of radius R misses it by h^2/2R,
+   i.e. by h/2R per unit of arc length, or h/2 per radian the line
+   turns. */
+Expected expected_baseline(const TraceOptions&)
+{
+  Expected e = {0, 0, EulerIntegrator::STEP/2};
+  return e;
+}
+
+const Engine engines[] = {
+  {"simd", "vectorized kernels, fast plate field", setup_simd, expected_simd},
+  {"barnes-hut", "Barnes-Hut tree", setup_barnes_hut, expected_barnes_hut},
+  {"field-grid", "sampled field grid", setup_field_grid, expected_field_grid},
+  {"edit", "split grid of all but one object", setup_edit, expected_edit},
+  {"rk45", "default integrator tolerance", setup_rk45, expected_rk45},
+  {"baseline", "original tracer, Euler steps", setup_baseline, expected_baseline}
+};
+const unsigned int N_ENGINES = sizeof(engines)/sizeof(engines[0]);
+
+struct Config
+{
+  Config(): max_field_error(-1), max_distance(-1), grid(12){};
+
+  std::vector<std::string> scenes;
+  std::vector<const Engine *> engines;
+  float max_field_error;  // for all engines instead of the expected, if >= 0
+  float max_distance;
+  unsigned int grid;
+};
+
+void usage()
+{
+  std::cerr << "Usage: elfelli-accuracy [--engine NAME]... [--max-field-error E]\n"
+            << "                        [--max-distance D] [--grid N] SCENE|DIR...\n"
+            << "Engines (all by default):\n";
+  for(unsigned int i=0; i<N_ENGINES; ++i)
+    fprintf(stderr, "  %-11s %s\n", engines[i].name, engines[i].description);
+}
+
+bool has_suffix(const std::string& s, const std::string& suffix)
+{
+  return s.size() >= suffix.size()
+    && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/* A directory stands for the scene files in it. */
+void add_scenes(const std::string& path, std::vector<std::string>& scenes)
+{
+  struct stat st;
+  DIR *dir;
+  if(stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || !(dir = opendir(path.c_str())))
+    {
+      scenes.push_back(path);
+      return;
+    }
+
+  std::vector<std::string> found;
+  while(struct dirent *entry = readdir(dir))
+    if(has_suffix(entry->d_name, ".elfelli"))
+      found.push_back(path + "/" + entry->d_name);
+  closedir(dir);
+
+  std::sort(found.begin(), found.end());
+  scenes.insert(scenes.end(), found.begin(), found.end());
+}
+
+bool parse(int argc, char **argv, Config& config)
+{
+  for(int i=1; i<argc; ++i)
+    {
+      std::string arg = argv[i];
+      bool has_value = i + 1 < argc;
+
+      if(arg == "--engine" && has_value)
+        {
+          std::string name = argv[++i];
+          unsigned int j = 0;
+          while(j < N_ENGINES && name != engines[j].name)
+            j++;
+          if(j == N_ENGINES)
+            {
+              std::cerr << "Unknown engine `" << name << "'." << std::endl;
+              return false;
+            }
+          config.engines.push_back(&engines[j]);
+        }
+      else if(arg == "--max-field-error" && has_value)
+        config.max_field_error = atof(argv[++i]);
+      else if(arg == "--max-distance" && has_value)
+        config.max_distance = atof(argv[++i]);
+      else if(arg == "--grid" && has_value)
+        config.grid = std::max(1, atoi(argv[++i]));
+      else if(arg.size() > 1 && arg[0] == '-')
+        return false;
+      else
+        add_scenes(arg, config.scenes);
+    }
+
+  if(config.engines.empty())
+    for(unsigned int i=0; i<N_ENGINES; ++i)
+      config.engines.push_back(&engines[i]);
+
+  return !config.scenes.empty();
+}
+
+/* Points every pixel of arc length along the first `limit' pixels of
+   the line; returns the length they cover. */
+float resample(const FluxLine& l, std::vector<Vec2>& points, float limit)
+{
+  points.clear();
+  if(l.size == 0)
+    return 0;
+
+  points.push_back(l[0]);
+  float s = 0, next = 1;
+  for(unsigned int i=1; i<l.size && s < limit; ++i)
+    {
+      float len = l[i-1].distance(l[i]);
+      while(next <= s + len && next <= limit)
+        {
+          points.push_back(l[i-1] + (l[i] - l[i-1])*((next - s)/len));
+          next += 1;
+        }
+      s += len;
+    }
+  return fmin(s, limit);
+}
+
+/* Distance of p from the segment a-b */
+float segment_distance(const Vec2& p, const Vec2& a, const Vec2& b)
+{
+  Vec2 d = b - a, q = p - a;
+  float u = (q.get_x()*d.get_x() + q.get_y()*d.get_y())/(d.get_x()*d.get_x() + d.get_y()*d.get_y());
+  return p.distance(a + d*fmax(0.0f, fmin(1.0f, u)));
+}
+
+/* Distance of the point i of a resampled line from the other line
+   `b', which has `nb' points, within SLIP pixels of arc length of it */
+float off_line(const Vec2 *a, unsigned int i, const Vec2 *b, unsigned int nb)
+{
+  const int slip = SLIP;
+  int first = std::max(0, static_cast<int>(i) - slip);
+  int last = std::min(static_cast<int>(nb) - 1, static_cast<int>(i) + slip);
+  if(last < 0)
+    return INFINITY;
+  if(first >= last)
+    return a[i].distance(b[last]);
+
+  float best = INFINITY;
+  for(int j=first; j<last; ++j)
+    best = fmin(best, segment_distance(a[i], b[j], b[j + 1]));
+  return best;
+}
+
+/* How far apart two resampled lines are: the farthest any point of
+   either is from the other line, over the part both cover but the
+   last END_SLACK pixels of lines that end before ARC, since lines
+   into the same body end at slightly different points.  If one of
+   them ends earlier than that explains, by how much counts instead
+   when it is more. */
+float apart(const Vec2 *a, unsigned int na, float la, const Vec2 *b, unsigned int nb, float lb)
+{
+  float worst = fmax(0.0f, fabs(la - lb) - END_SLACK);
+  float compared = fmin(la, lb);
+  if(compared < ARC + SLIP)
+    compared -= END_SLACK;
+  compared = fmin(compared, ARC);
+  for(unsigned int i=0; i<compared; ++i)
+    {
+      if(i < na)
+        worst = fmax(worst, off_line(a, i, b, nb));
+      if(i < nb)
+        worst = fmax(worst, off_line(b, i, a, na));
+    }
+  return worst;
+}
+
+/* How far a resampled line turns in all, in radians */
+float turning(const std::vector<Vec2>& points)
+{
+  float sum = 0;
+  for(unsigned int i=2; i<points.size(); ++i)
+    {
+      Vec2 a = points[i-1] - points[i-2], b = points[i] - points[i-1];
+      float cross = a.get_x()*b.get_y() - a.get_y()*b.get_x();
+      float dot = a.get_x()*b.get_x() + a.get_y()*b.get_y();
+      sum += fabs(atan2(cross, dot));
+    }
+  return sum;
+}
+
+/* A line of the reference, resampled every pixel of arc length */
+struct Golden
+{
+  std::vector<Vec2> points;
+  float length;
+  float turning;
+};
+
+/* How far the field of `sim' turns a line off the reference line
+   `g' to first order: the angle between the two fields, summed over
+   every pixel of the line. */
+float field_drift(const Simulation& reference, const Simulation& sim, const Golden& g)
+{
+  float sum = 0;
+  for(unsigned int i=0; i<g.points.size(); ++i)
+    {
+      Vec2 a = reference.force_at(g.points[i], 1), b = sim.trace_force(g.points[i], 1);
+      float cross = a.get_x()*b.get_y() - a.get_y()*b.get_x();
+      float dot = a.get_x()*b.get_x() + a.get_y()*b.get_y();
+      sum += fabs(atan2(cross, dot));
+    }
+  return sum;
+}
+
+/* How far another line may be from each of the reference, given the
+   error `error[i]' an engine is expected to make along the whole of
+   line i.  Every CHECKPOINT pixels along the line the reference is
+   followed once more from that far to either side, but at least
+   MIN_SHIFT, and the gain of the line is the most the rest of it moved
+   per pixel of shift.  An error made anywhere along the line moves it
+   by no more than the error times the gain, to first order.
+
+   Where a line shifted that little ends somewhere else, or at another
+   length, it passes close to a saddle point or the edge of a body, and
+   no engine can be held to a bound on it; its bound is infinite.  The
+   least shift is about how far apart the points are at which different
+   integrators test whether a line ended. */
+std::vector<float> line_bounds(Simulation& reference, const std::vector<Golden>& golden,
+                               const std::vector<float>& error)
+{
+  const float CHECKPOINT = 50;
+  const float MIN_SHIFT = 1;
+  const float ELSEWHERE = ARC/4;
+
+  struct Shift
+  {
+    unsigned int line, at;
+  };
+  std::vector<Shift> shifts;
+  std::vector<Vec2> starts;
+  for(unsigned int i=0; i<golden.size(); ++i)
+    for(unsigned int at=0; at + 1 < golden[i].points.size(); at += CHECKPOINT)
+      {
+        Vec2 p = golden[i].points[at], d = golden[i].points[at + 1] - p;
+        Vec2 side = Vec2(-d.get_y(), d.get_x())/d.length()*fmax(error[i], MIN_SHIFT);
+        Shift s = {i, at};
+        shifts.push_back(s);
+        shifts.push_back(s);
+        starts.push_back(p + side);
+        starts.push_back(p - side);
+      }
+
+  FluxLines lines;
+  reference.follow(starts, 1, MAX_STEPS, &lines);
+
+  std::vector<float> gain(golden.size(), 1);
+  std::vector<Vec2> points;
+  for(unsigned int i=0; i<shifts.size(); ++i)
+    {
+      const unsigned int line = shifts[i].line, at = shifts[i].at;
+      const Golden& g = golden[line];
+      float length = resample(lines[i], points, ARC + SLIP - at);
+      float moved = apart(&g.points[at], g.points.size() - at, g.length - at,
+                          points.data(), points.size(), length);
+      if(moved > ELSEWHERE || fabs(g.length - at - length) > END_SLACK)
+        gain[line] = INFINITY;
+      else
+        gain[line] = fmax(gain[line], moved/fmax(error[line], MIN_SHIFT));
+    }
+
+  std::vector<float> bound(golden.size());
+  for(unsigned int i=0; i<golden.size(); ++i)
+    bound[i] = gain[i]*error[i];
+  return bound;
+}
+
+/* Bounding box of all objects, with a margin */
+void scene_rect(const Simulation& sim, float& x0, float& y0, float& x1, float& y1)
+{
+  std::vector<Vec2> points;
+  for(unsigned int i=0; i<sim.get_bodies().size(); ++i)
+    points.push_back(sim.get_bodies()[i].pos);
+  for(unsigned int i=0; i<sim.get_plates().size(); ++i)
+    {
+      points.push_back(sim.get_plates()[i].pos_a);
+      points.push_back(sim.get_plates()[i].pos_b);
+    }
+
+  x0 = y0 = 1e30;
+  x1 = y1 = -1e30;
+  for(unsigned int i=0; i<points.size(); ++i)
+    {
+      x0 = fmin(x0, points[i].get_x());
+      y0 = fmin(y0, points[i].get_y());
+      x1 = fmax(x1, points[i].get_x());
+      y1 = fmax(y1, points[i].get_y());
+    }
+  x0 -= MARGIN;
+  y0 -= MARGIN;
+  x1 += MARGIN;
+  y1 += MARGIN;
+}
+
+/* Starts on a grid over the scene, except right next to a body or
+   plate, where a line may count as absorbed from the start or not.
+   They are off the centres of the cells, so that they are not on the
+   lines of symmetry of a regular scene, which run straight into its
+   saddle points. */
+std::vector<Vec2> line_starts(const Simulation& sim, float x0, float y0, float x1, float y1,
+                              unsigned int grid)
+{
+  const float CLEARANCE = 12;
+  const float OFFSET_X = 0.382, OFFSET_Y = 0.447;
+
+  std::vector<Vec2> starts;
+  for(unsigned int j=0; j<grid; ++j)
+    for(unsigned int i=0; i<grid; ++i)
+      {
+        Vec2 p(x0 + (i + OFFSET_X)*(x1 - x0)/grid, y0 + (j + OFFSET_Y)*(y1 - y0)/grid);
+
+        bool clear = true;
+        for(unsigned int k=0; k<sim.get_bodies().size() && clear; ++k)
+          clear = p.distance(sim.get_bodies()[k].pos) > CLEARANCE;
+        for(unsigned int k=0; k<sim.get_plates().size() && clear; ++k)
+          clear = segment_distance(p, sim.get_plates()[k].pos_a, sim.get_plates()[k].pos_b) > CLEARANCE;
+        if(clear)
+          starts.push_back(p);
+      }
+  return starts;
+}
+
+/* The points of a drawing every pixel along its lines, as far as
+   they are in the view of `opts', in cells of CELL pixels for finding
+   the nearest one.  Outside the view lines are only traced to be
+   continued, and they part farther there than anyone sees. */
+class Drawing
+{
+public:
+  Drawing(const FluxLines& lines, const TraceOptions& opts)
+  {
+    x0 = opts.view_x0;
+    y0 = opts.view_y0;
+    std::vector<Vec2> line;
+    for(unsigned int i=0; i<lines.size(); ++i)
+      {
+        resample(lines[i], line, INFINITY);
+        for(unsigned int k=0; k<line.size(); ++k)
+          if(line[k].get_x() >= opts.view_x0 && line[k].get_x() < opts.view_x1
+             && line[k].get_y() >= opts.view_y0 && line[k].get_y() < opts.view_y1)
+            points.push_back(line[k]);
+      }
+    w = (opts.view_x1 - x0)/CELL + 1;
+    h = (opts.view_y1 - y0)/CELL + 1;
+
+    /* Counting sort of the points by cell */
+    std::vector<unsigned int> cell(points.size());
+    start.assign(w*h + 1, 0);
+    for(unsigned int i=0; i<points.size(); ++i)
+      {
+        cell[i] = cell_of(points[i]);
+        start[cell[i] + 1]++;
+      }
+    for(unsigned int c=0; c<w*h; ++c)
+      start[c + 1] += start[c];
+    sorted.resize(points.size());
+    std::vector<unsigned int> fill(start.begin(), start.end() - 1);
+    for(unsigned int i=0; i<points.size(); ++i)
+      sorted[fill[cell[i]]++] = points[i];
+  };
+
+  const std::vector<Vec2>& get_points() const{return points;};
+
+  /* Distance to the nearest point, or `limit' if that is nearer */
+  float nearest(const Vec2& p, float limit) const
+  {
+    if(points.empty())
+      return limit;
+
+    int cx = (p.get_x() - x0)/CELL, cy = (p.get_y() - y0)/CELL;
+    float best = limit;
+    for(int r=0; r*CELL - CELL < best; ++r)
+      for(int j=cy-r; j<=cy+r; ++j)
+        for(int i=cx-r; i<=cx+r; ++i)
+          {
+            if((abs(i - cx) != r && abs(j - cy) != r)
+               || i < 0 || j < 0 || i >= static_cast<int>(w) || j >= static_cast<int>(h))
+              continue;
+            unsigned int c = j*w + i;
+            for(unsigned int k=start[c]; k<start[c + 1]; ++k)
+              best = fmin(best, p.distance(sorted[k]));
+          }
+    return best;
+  };
+
+private:
+  static constexpr float CELL = 8;
+
+  unsigned int cell_of(const Vec2& p) const
+  {
+    return static_cast<unsigned int>((p.get_y() - y0)/CELL)*w
+      + static_cast<unsigned int>((p.get_x() - x0)/CELL);
+  };
+
+  std::vector<Vec2> points, sorted;
+  std::vector<unsigned int> start;
+  float x0, y0;
+  unsigned int w, h;
+};
+
+float percentile(const std::vector<float>& sorted, unsigned int p)
+{
+  return sorted.empty() ? 0 : sorted[(sorted.size() - 1)*p/100];
+}
+
+/* How far the drawing of an engine is from the reference drawing,
+   by the distance of every point of either from the nearest of the
+   other: its 99th percentile and maximum, the most it exceeds the
+   bounds at any of the PERCENTILES, and the share of the points that
+   are farther off than the largest bound. */
+struct DrawingError
+{
+  float p99, max;
+  float worst;
+  float outliers;
+};
+
+DrawingError compare_drawings(const FluxLines& a, const FluxLines& b, const TraceOptions& opts,
+                              const std::vector<float>& sorted_bound)
+{
+  const unsigned int PERCENTILES[] = {90, 95, 99};
+
+  Drawing da(a, opts), db(b, opts);
+  std::vector<float> dist;
+  for(unsigned int i=0; i<da.get_points().size(); ++i)
+    dist.push_back(db.nearest(da.get_points()[i], ARC));
+  for(unsigned int i=0; i<db.get_points().size(); ++i)
+    dist.push_back(da.nearest(db.get_points()[i], ARC));
+  std::sort(dist.begin(), dist.end());
+
+  DrawingError e = {percentile(dist, 99), dist.empty() ? 0 : dist.back(), 0, 0};
+  if(sorted_bound.empty())
+    return e;
+  for(unsigned int i=0; i<sizeof(PERCENTILES)/sizeof(PERCENTILES[0]); ++i)
+    e.worst = fmax(e.worst, percentile(dist, PERCENTILES[i])/percentile(sorted_bound, PERCENTILES[i]));
+  if(!dist.empty())
+    e.outliers = (dist.end() - std::upper_bound(dist.begin(), dist.end(), sorted_bound.back()))
+      / static_cast<float>(dist.size());
+  return e;
+}
+
+/* Returns whether the scene is within the bounds for every engine. */
+bool check_scene(const std::string& filename, const Config& config)
+{
+  Simulation reference;
+  XmlLoader loader;
+  if(loader.load(filename.c_str(), &reference) != 0)
+    {
+      std::cerr << "Could not load `" << filename << "'." << std::endl;
+      return false;
+    }
+
+  TraceOptions opts;
+  opts.threads = 1;
+  opts.vectorize = false;
+  opts.integrator = INTEGRATOR_RK45;
+  opts.tolerance = REFERENCE_TOLERANCE;
+  opts.simplify = 0;
+  reference.set_options(opts);
+
+  /* Without a view, so that no line stops early at its edge */
+  float x0, y0, x1, y1;
+  scene_rect(reference, x0, y0, x1, y1);
+  std::vector<Vec2> starts = line_starts(reference, x0, y0, x1, y1, config.grid);
+  FluxLines lines;
+  reference.follow(starts, 1, MAX_STEPS, &lines);
+  std::vector<Golden> golden(starts.size());
+  for(unsigned int i=0; i<starts.size(); ++i)
+    {
+      golden[i].length = resample(lines[i], golden[i].points, ARC + SLIP);
+      golden[i].turning = turning(golden[i].points);
+    }
+
+  /* The whole drawing, as the program makes it of the scene */
+  TraceOptions drawn = opts;
+  drawn.simplify = TraceOptions().simplify;
+  drawn.skip_arrived = false;
+  drawn.view_x0 = x0;
+  drawn.view_y0 = y0;
+  drawn.view_x1 = x1;
+  drawn.view_y1 = y1;
+  reference.set_options(drawn);
+  reference.run();
+  FluxLines drawing = reference.get_result();
+  reference.set_options(opts);
+
+  std::string name = filename.substr(filename.rfind('/') + 1);
+  bool ok = true;
+  for(unsigned int e=0; e<config.engines.size(); ++e)
+    {
+      const Engine& engine = *config.engines[e];
+
+      Simulation sim = reference;
+      TraceOptions alt = opts;
+      engine.setup(sim, alt);
+      sim.set_options(alt);
+
+      FieldError err = sim.field_error(FIELD_SAMPLES);
+
+      /* Nothing is expected to be more exact than the reference. */
+      Expected expected = engine.expected(alt);
+      float max_field_error = fmax(expected.field, ROUNDING);
+      if(config.max_field_error >= 0)
+        max_field_error = config.max_field_error;
+
+      lines.clear();
+      sim.follow(starts, 1, MAX_STEPS, &lines);
+
+      /* What the engine gets wrong along each line: the turn its field
+         gives the line, what its integrator and the reference miss */
+      std::vector<float> error(starts.size());
+      for(unsigned int i=0; i<starts.size(); ++i)
+        error[i] = field_drift(reference, sim, golden[i])
+          + (expected.drift + REFERENCE_TOLERANCE)*golden[i].length
+          + expected.bend*golden[i].turning;
+      std::vector<float> bound = line_bounds(reference, golden, error);
+
+      /* Every line with a bound, as far as the worst of them */
+      std::vector<float> dist;
+      std::vector<Vec2> points;
+      float worst = 0;
+      for(unsigned int i=0; i<starts.size(); ++i)
+        if(bound[i] < INFINITY)
+          {
+            const Golden& g = golden[i];
+            float length = resample(lines[i], points, ARC + SLIP);
+            dist.push_back(apart(g.points.data(), g.points.size(), g.length,
+                                 points.data(), points.size(), length));
+
+            float b = config.max_distance >= 0 ? config.max_distance : bound[i] + RESOLUTION;
+            worst = fmax(worst, dist.back()/b);
+          }
+      std::sort(dist.begin(), dist.end());
+
+      /* The drawing, against the bounds of the lines above with the
+         points the simplification of both drawings may move */
+      std::vector<float> drawn_bound;
+      for(unsigned int i=0; i<bound.size(); ++i)
+        if(bound[i] < INFINITY)
+          drawn_bound.push_back(config.max_distance >= 0 ? config.max_distance
+                                : bound[i] + RESOLUTION + 2*drawn.simplify);
+      std::sort(drawn_bound.begin(), drawn_bound.end());
+
+      TraceOptions alt_drawn = drawn;
+      engine.setup(sim, alt_drawn);
+      sim.set_options(alt_drawn);
+      sim.run();
+      DrawingError drawing_error = compare_drawings(drawing, sim.get_result(), drawn, drawn_bound);
+
+      bool pass = err.rms_relative <= max_field_error && worst <= 1
+        && drawing_error.worst <= 1 && drawing_error.outliers <= OUTLIERS;
+      ok = ok && pass;
+
+      printf("%-26s %-10s %9.2e %9.2e %9.2e %9.5f %5u/%-3u %7.3f %7.3f %6.2f %7.3f %7.3f %6.2f %7.3f  %s\n",
+             name.c_str(), engine.name, err.rms_relative, max_field_error, err.max_relative,
+             err.max_angle, static_cast<unsigned int>(dist.size()),
+             static_cast<unsigned int>(starts.size()), percentile(dist, 95),
+             dist.empty() ? 0 : dist.back(), worst, drawing_error.p99, drawing_error.max,
+             drawing_error.worst, 100*drawing_error.outliers, pass ? "ok" : "FAIL");
+    }
+
+  return ok;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+  Config config;
+  if(!parse(argc, argv, config))
+    {
+      usage();
+      return 2;
+    }
+
+  printf("%-26s %-10s %9s %9s %9s %9s %9s %7s %7s %6s %7s %7s %6s %7s\n", "scene", "engine",
+         "rms rel", "bound", "max rel", "max deg", "lines", "p95 px", "max px", "/bound",
+         "drawn99", "drawnmx", "/bound", "outl %");
+
+  unsigned int failed = 0;
+  for(unsigned int i=0; i<config.scenes.size(); ++i)
+    if(!check_scene(config.scenes[i], config))
+      failed++;
+
+  printf("%u of %u scenes within the bounds\n",
+         static_cast<unsigned int>(config.scenes.size()) - failed,
+         static_cast<unsigned int>(config.scenes.size()));
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,408 @@
+/*
+ * Benchmark.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* Times the simulation core on generated scenes and writes the results
+   as JSON:
+
+     elfelli-bench [-o FILE] [--sizes 10,100,...] [--kinds dipoles,...]
+                   [--threads N] [--repeat R]
+
+   For every scene it measures the reference force_at(), the
+   trace_force() the lines are really traced with, the same with the
+   Barnes-Hut tree and its error, the capture test against a linear
+   scan over all objects, setting up for tracing, single steps along the field, and run() as a whole, plus
+   the size of the result and the peak memory of the process so far.
+   Everything but run() uses a single thread. */
+
+#include "SceneGenerator.h"
+#include "Simulation.h"
+#include "CaptureGrid.h"
+#include "FieldKernel.h"
+#include "QuadTree.h"
+#include "Parallel.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Elfelli;
+
+namespace
+{
+
+/* About this many body-point interactions per throughput measurement */
+const double INTERACTIONS = 2e7;
+
+const unsigned int STEP_PARTICLES = 256;
+const unsigned int STEP_LIMIT = 500;
+
+/* Capture radii of bodies and plates, as Simulation::prepare() builds
+   its CaptureGrid */
+const float BODY_RADIUS = 5;
+const float PLATE_RADIUS = 3;
+
+/* Random points the error of the Barnes-Hut field is measured at */
+const unsigned int ERROR_SAMPLES = 2000;
+
+typedef std::chrono::steady_clock Clock;
+
+double ms_since(const Clock::time_point& start)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct Config
+{
+  Config(): threads(0), repeat(1){};
+
+  std::string output;
+  std::vector<unsigned int> sizes;
+  std::vector<SceneKind> kinds;
+  unsigned int threads;
+  unsigned int repeat;
+};
+
+void usage()
+{
+  std::cerr << "Usage: elfelli-bench [-o FILE] [--sizes 10,100,...] [--kinds dipoles,...]\n"
+            << "                     [--threads N] [--repeat R]\n"
+            << "Kinds: dipoles, lattice, capacitors, mixed." << std::endl;
+}
+
+std::vector<std::string> split(const std::string& s)
+{
+  std::vector<std::string> parts;
+  std::stringstream in(s);
+  std::string part;
+  while(std::getline(in, part, ','))
+    if(!part.empty())
+      parts.push_back(part);
+  return parts;
+}
+
+bool parse(int argc, char **argv, Config& config)
+{
+  for(int i=1; i<argc; ++i)
+    {
+      std::string arg = argv[i];
+      bool has_value = i + 1 < argc;
+
+      if(arg == "-o" && has_value)
+        config.output = argv[++i];
+      else if(arg == "--sizes" && has_value)
+        {
+          std::vector<std::string> parts = split(argv[++i]);
+          for(unsigned int j=0; j<parts.size(); ++j)
+            {
+              /* Every object might be a body, and add_body() drops those
+                 beyond MAX_BODIES. */
+              char *end;
+              long n = strtol(parts[j].c_str(), &end, 10);
+              if(parts[j].empty() || *end != '\0' || n < 1 || n > MAX_BODIES)
+                {
+                  std::cerr << "Invalid scene size `" << parts[j] << "', must be 1 to "
+                            << MAX_BODIES << "." << std::endl;
+                  return false;
+                }
+              config.sizes.push_back(n);
+            }
+        }
+      else if(arg == "--kinds" && has_value)
+        {
+          std::vector<std::string> parts = split(argv[++i]);
+          for(unsigned int j=0; j<parts.size(); ++j)
+            {
+              SceneKind kind;
+              if(!scene_kind_from_name(parts[j], kind))
+                {
+                  std::cerr << "Unknown scene kind `" << parts[j] << "'." << std::endl;
+                  return false;
+                }
+              config.kinds.push_back(kind);
+            }
+        }
+      else if(arg == "--threads" && has_value)
+        {
+          if(!parse_threads(argv[++i], config.threads))
+            {
+              std::cerr << "Invalid thread count `" << argv[i] << "'." << std::endl;
+              return false;
+            }
+        }
+      else if(arg == "--repeat" && has_value)
+        config.repeat = std::max(1, atoi(argv[++i]));
+      else
+        return false;
+    }
+
+  if(config.sizes.empty())
+    {
+      unsigned int sizes[] = {10, 100, 1000, 10000};
+      config.sizes.assign(sizes, sizes + 4);
+    }
+  if(config.kinds.empty())
+    for(int i=0; i<SCENE_KINDS_NUM; ++i)
+      config.kinds.push_back(static_cast<SceneKind>(i));
+
+  return true;
+}
+
+/* Peak resident memory of the process, in kilobytes on Linux */
+long peak_rss()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+void write_rate(std::ostream& out, const char *name, const char *unit,
+                unsigned long count, double ms)
+{
+  out << "      \"" << name << "\": {\"" << unit << "\": " << count
+      << ", \"ms\": " << ms
+      << ", \"per_second\": " << (ms > 0 ? count/(ms*1e-3) : 0) << "}";
+}
+
+float distance2(float px, float py, const Vec2& a, const Vec2& b)
+{
+  float dx = b.get_x() - a.get_x(), dy = b.get_y() - a.get_y();
+  px -= a.get_x();
+  py -= a.get_y();
+  float l2 = dx*dx + dy*dy;
+  float u = l2 > 0 ? fmax(0.0f, fmin(1.0f, (px*dx + py*dy)/l2)) : 0;
+  px -= u*dx;
+  py -= u*dy;
+  return px*px + py*py;
+}
+
+/* Whether each point is within the capture radius of an object, once by
+   looking at every object and once with the CaptureGrid the tracer
+   uses; both must find the same points. */
+void bench_capture(std::ostream& out, const Simulation& sim, const std::vector<Vec2>& points)
+{
+  const std::vector<Body>& bodies = sim.get_bodies();
+  const std::vector<PlateBody>& plates = sim.get_plates();
+  const float rb2 = BODY_RADIUS*BODY_RADIUS, rp2 = PLATE_RADIUS*PLATE_RADIUS;
+
+  unsigned int linear_hits = 0;
+  Clock::time_point start = Clock::now();
+  for(unsigned int i=0; i<points.size(); ++i)
+    {
+      float px = points[i].get_x(), py = points[i].get_y();
+      bool hit = false;
+      for(unsigned int j=0; j<bodies.size() && !hit; ++j)
+        hit = distance2(px, py, bodies[j].pos, bodies[j].pos) <= rb2;
+      for(unsigned int j=0; j<plates.size() && !hit; ++j)
+        hit = distance2(px, py, plates[j].pos_a, plates[j].pos_b) <= rp2;
+      linear_hits += hit;
+    }
+  double linear_ms = ms_since(start);
+
+  start = Clock::now();
+  CaptureGrid grid;
+  grid.build(bodies, plates, BODY_RADIUS, PLATE_RADIUS);
+  double build_ms = ms_since(start);
+
+  unsigned int grid_hits = 0;
+  start = Clock::now();
+  for(unsigned int i=0; i<points.size(); ++i)
+    {
+      float px = points[i].get_x(), py = points[i].get_y();
+      grid_hits += grid.find(px, py, px, py,
+                             [&](unsigned int j)
+                             {return distance2(px, py, bodies[j].pos, bodies[j].pos) <= rb2;},
+                             [&](unsigned int j)
+                             {return distance2(px, py, plates[j].pos_a, plates[j].pos_b) <= rp2;});
+    }
+  double grid_ms = ms_since(start);
+
+  if(grid_hits != linear_hits)
+    std::cerr << "capture grid found " << grid_hits << " points, the linear scan "
+              << linear_hits << std::endl;
+
+  out << "      \"capture\": {\"tests\": " << points.size()
+      << ", \"hits\": " << grid_hits
+      << ", \"linear_ms\": " << linear_ms
+      << ", \"grid_ms\": " << grid_ms
+      << ", \"build_ms\": " << build_ms
+      << ", \"speedup\": " << (grid_ms > 0 ? linear_ms/grid_ms : 0) << "},\n";
+}
+
+void bench_scene(std::ostream& out, const Config& config, SceneKind kind, unsigned int n)
+{
+  Simulation sim;
+  float size = generate_scene(sim, kind, n);
+
+  TraceOptions opts;
+  opts.threads = config.threads;
+  opts.view_x0 = opts.view_y0 = 0;
+  opts.view_x1 = opts.view_y1 = size;
+  sim.set_options(opts);
+
+  unsigned int sources = sim.get_bodies().size() + sim.get_plates().size();
+  std::mt19937 rng(2);
+  std::vector<Vec2> points(std::max(1000.0, std::min(200000.0, INTERACTIONS/std::max(1u, sources))));
+  for(unsigned int i=0; i<points.size(); ++i)
+    points[i] = Vec2(size*(rng()/4294967296.0), size*(rng()/4294967296.0));
+
+  float sink = 0;
+  Clock::time_point start = Clock::now();
+  for(unsigned int i=0; i<points.size(); ++i)
+    sink += sim.force_at(points[i], 1).get_x();
+  double force_ms = ms_since(start);
+
+  /* follow() sets up the acceleration structures first; timed on its
+     own without any particles. */
+  start = Clock::now();
+  sim.follow(std::vector<Vec2>(), 1, 0);
+  double prepare_ms = ms_since(start);
+
+  std::vector<Vec2> starts(points.begin(), points.begin() + std::min<size_t>(STEP_PARTICLES, points.size()));
+  start = Clock::now();
+  unsigned long steps = sim.follow(starts, 1, STEP_LIMIT);
+  double step_ms = std::max(0.0, ms_since(start) - prepare_ms);
+
+  /* follow() has set up what trace_force() needs */
+  start = Clock::now();
+  for(unsigned int i=0; i<points.size(); ++i)
+    sink += sim.trace_force(points[i], 1).get_x();
+  double trace_force_ms = ms_since(start);
+
+  /* The same with the Barnes-Hut tree, how long building the tree on
+     its own takes, and how far it is off the exact field */
+  BodyArrays arrays;
+  for(unsigned int i=0; i<sim.get_bodies().size(); ++i)
+    arrays.add(sim.get_bodies()[i].pos.get_x(), sim.get_bodies()[i].pos.get_y(),
+               sim.get_bodies()[i].charge);
+  QuadTree tree;
+  start = Clock::now();
+  tree.build(arrays);
+  double tree_build_ms = ms_since(start);
+
+  TraceOptions tree_opts = opts;
+  tree_opts.barnes_hut = true;
+  sim.set_options(tree_opts);
+  sim.follow(std::vector<Vec2>(), 1, 0);
+  start = Clock::now();
+  for(unsigned int i=0; i<points.size(); ++i)
+    sink += sim.trace_force(points[i], 1).get_x();
+  double tree_ms = ms_since(start);
+  FieldError tree_error = sim.field_error(ERROR_SAMPLES);
+  sim.set_options(opts);
+
+  double run_ms = 0;
+  for(unsigned int r=0; r<config.repeat; ++r)
+    {
+      start = Clock::now();
+      sim.run();
+      double ms = ms_since(start);
+      run_ms = r == 0 ? ms : std::min(run_ms, ms);
+    }
+  const FluxLines& result = sim.get_result();
+
+  out << "    {\n"
+      << "      \"kind\": \"" << scene_kind_name(kind) << "\",\n"
+      << "      \"objects\": " << sim.get_bodies().size() + sim.get_plates().size() << ",\n"
+      << "      \"bodies\": " << sim.get_bodies().size() << ",\n"
+      << "      \"plates\": " << sim.get_plates().size() << ",\n"
+      << "      \"size\": " << size << ",\n";
+  write_rate(out, "force_at", "evaluations", points.size(), force_ms);
+  out << ",\n";
+  write_rate(out, "trace_force", "evaluations", points.size(), trace_force_ms);
+  out << ",\n";
+  write_rate(out, "barnes_hut", "evaluations", points.size(), tree_ms);
+  out << ",\n"
+      << "      \"barnes_hut_tree\": {\"build_ms\": " << tree_build_ms
+      << ", \"rms_relative\": " << tree_error.rms_relative
+      << ", \"max_relative\": " << tree_error.max_relative << "},\n";
+  bench_capture(out, sim, points);
+  out << "      \"prepare\": {\"ms\": " << prepare_ms << "},\n";
+  write_rate(out, "step", "steps", steps, step_ms);
+  out << ",\n"
+      << "      \"run\": {\"ms\": " << run_ms
+      << ", \"lines\": " << result.size()
+      << ", \"points\": " << result.n_points()
+      << ", \"result_bytes\": " << result.bytes() << "},\n"
+      << "      \"peak_rss_kb\": " << peak_rss() << ",\n"
+      << "      \"checksum\": " << sink << "\n"
+      << "    }";
+
+  std::cerr << scene_kind_name(kind) << " " << sim.get_bodies().size() + sim.get_plates().size()
+            << ": run " << run_ms << " ms, "
+            << result.n_points() << " points" << std::endl;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+  Config config;
+  if(!parse(argc, argv, config))
+    {
+      usage();
+      return 2;
+    }
+
+  std::ostringstream out;
+  out << "{\n"
+      << "  \"kernel\": \"" << body_field_isa() << "\",\n"
+      << "  \"threads\": " << (config.threads ? config.threads : hardware_threads()) << ",\n"
+      << "  \"repeat\": " << config.repeat << ",\n"
+      << "  \"scenes\": [\n";
+
+  /* Smallest first, so the peak memory of every scene is about its own */
+  std::vector<unsigned int> sizes = config.sizes;
+  std::sort(sizes.begin(), sizes.end());
+  bool first = true;
+  for(unsigned int i=0; i<sizes.size(); ++i)
+    for(unsigned int j=0; j<config.kinds.size(); ++j)
+      {
+        if(!first)
+          out << ",\n";
+        first = false;
+        bench_scene(out, config, config.kinds[j], sizes[i]);
+      }
+
+  out << "\n  ]\n}\n";
+
+  if(config.output.empty())
+    std::cout << out.str();
+  else
+    {
+      FILE *f = fopen(config.output.c_str(), "w");
+      if(!f)
+        {
+          std::cerr << "Could not write `" << config.output << "'." << std::endl;
+          return 1;
+        }
+      fputs(out.str().c_str(), f);
+      fclose(f);
+    }
+
+  return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * SceneGenerator.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "SceneGenerator.h"
+
+#include <algorithm>
+#include <random>
+#include <math.h>
+
+namespace Elfelli
+{
+
+static const char *kind_names[SCENE_KINDS_NUM] = {"dipoles", "lattice", "capacitors", "mixed"};
+
+/* Objects are about this far apart, and this far from the edges. */
+static const float SPACING = 40;
+static const float BORDER = 80;
+
+const char *scene_kind_name(SceneKind kind)
+{
+  return kind_names[kind];
+}
+
+bool scene_kind_from_name(const std::string& name, SceneKind& kind)
+{
+  for(int i=0; i<SCENE_KINDS_NUM; ++i)
+    if(name == kind_names[i])
+      {
+        kind = static_cast<SceneKind>(i);
+        return true;
+      }
+
+  return false;
+}
+
+/* The distributions of <random> differ between standard libraries, the
+   raw output of mt19937 does not. */
+static float uniform(std::mt19937& rng, float a, float b)
+{
+  return a + (b - a)*static_cast<float>(rng()/4294967296.0);
+}
+
+static float random_sign(std::mt19937& rng)
+{
+  return (rng() & 1) ? 1 : -1;
+}
+
+static float random_charge(std::mt19937& rng, float max)
+{
+  return floor(uniform(rng, 1, max + 1));
+}
+
+static void add_random_plate(Simulation& sim, std::mt19937& rng, float x0, float x1)
+{
+  Vec2 centre(uniform(rng, x0, x1), uniform(rng, x0, x1));
+  float angle = uniform(rng, 0, PI);
+  Vec2 half = Vec2(cos(angle), sin(angle))*(0.5*uniform(rng, 30, 80));
+  sim.add_plate(centre - half, centre + half, random_sign(rng)*random_charge(rng, 4));
+}
+
+float generate_scene(Simulation& sim, SceneKind kind, unsigned int n, unsigned int seed)
+{
+  std::mt19937 rng(seed);
+
+  sim.reset();
+
+  /* Every object might be a body; the scene is complete, only smaller. */
+  n = std::min(n, static_cast<unsigned int>(MAX_BODIES));
+
+  float size = SPACING*sqrt(static_cast<float>(n)) + 2*BORDER;
+  float x0 = BORDER, x1 = size - BORDER;
+
+  switch(kind)
+    {
+    case SCENE_DIPOLES:
+      for(unsigned int i=0; i+1<n; i+=2)
+        {
+          Vec2 centre(uniform(rng, x0, x1), uniform(rng, x0, x1));
+          float angle = uniform(rng, 0, 2*PI);
+          Vec2 half = Vec2(cos(angle), sin(angle))*(0.5*uniform(rng, 20, 60));
+          float q = random_charge(rng, 4);
+          sim.add_body(centre + half, q);
+          sim.add_body(centre - half, -q);
+        }
+      break;
+
+    case SCENE_LATTICE:
+      {
+        unsigned int k = static_cast<unsigned int>(ceil(sqrt(static_cast<float>(n))));
+        float step = (x1 - x0)/k;
+        for(unsigned int i=0; i<n; ++i)
+          {
+            unsigned int row = i/k, col = i%k;
+            sim.add_body(Vec2(x0 + (col + 0.5)*step, x0 + (row + 0.5)*step),
+                         ((row + col) & 1) ? -2 : 2);
+          }
+        break;
+      }
+
+    case SCENE_CAPACITORS:
+      {
+        unsigned int pairs = n/2;
+        unsigned int k = static_cast<unsigned int>(ceil(sqrt(static_cast<float>(pairs))));
+        float step = (x1 - x0)/k;
+        float half_length = 0.3*step, half_gap = 0.15*step;
+        for(unsigned int i=0; i<pairs; ++i)
+          {
+            Vec2 centre(x0 + (i%k + 0.5)*step, x0 + (i/k + 0.5)*step);
+            float q = random_charge(rng, 4);
+            if(rng() & 1)
+              {
+                sim.add_plate(centre + Vec2(-half_length, -half_gap), centre + Vec2(half_length, -half_gap), q);
+                sim.add_plate(centre + Vec2(-half_length, half_gap), centre + Vec2(half_length, half_gap), -q);
+              }
+            else
+              {
+                sim.add_plate(centre + Vec2(-half_gap, -half_length), centre + Vec2(-half_gap, half_length), q);
+                sim.add_plate(centre + Vec2(half_gap, -half_length), centre + Vec2(half_gap, half_length), -q);
+              }
+          }
+        break;
+      }
+
+    case SCENE_MIXED:
+    default:
+      for(unsigned int i=0; i<n; ++i)
+        {
+          if(i%5 == 4)
+            add_random_plate(sim, rng, x0, x1);
+          else
+            sim.add_body(Vec2(uniform(rng, x0, x1), uniform(rng, x0, x1)),
+                         random_sign(rng)*random_charge(rng, 4));
+        }
+      break;
+    }
+
+  return size;
+}
+
+}
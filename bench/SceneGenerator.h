@@ -0,0 +1,51 @@
+// -*- C++ -*-
+/*
+ * SceneGenerator.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _SCENE_GENERATOR_H_
+#define _SCENE_GENERATOR_H_
+
+#include <string>
+
+#include "Simulation.h"
+
+namespace Elfelli
+{
+
+enum SceneKind
+  {
+    SCENE_DIPOLES = 0,  // pairs of opposite bodies, anywhere
+    SCENE_LATTICE,      // bodies on a square grid, alternating in sign
+    SCENE_CAPACITORS,   // pairs of opposite parallel plates on a grid
+    SCENE_MIXED,        // four bodies to every plate, anywhere
+    SCENE_KINDS_NUM
+  };
+
+const char *scene_kind_name(SceneKind kind);
+bool scene_kind_from_name(const std::string& name, SceneKind& kind);
+
+/* Replaces the scene of `sim' by about n objects of the given kind in a
+   square that grows with sqrt(n), so that they are about as dense at
+   every size; returns the edge length of the square, which starts at
+   (0, 0).  n is at most MAX_BODIES.  The same seed always gives the same scene. */
+float generate_scene(Simulation& sim, SceneKind kind, unsigned int n, unsigned int seed=1);
+
+}
+
+#endif // _SCENE_GENERATOR_H_
@@ -2,8 +2,16 @@
 
 set -e
 
+# The GUI is built explicitly, so that a missing gtkmm fails the build
+# instead of leaving SimulationWorker and the rest of it out.
 if [ "$BUILDSYSTEM" = "scons" ]; then
-  scons -j3
+  scons -j3 gui=1
+  elfelli=src/elfelli
 else
-  cmake . && make -j3
+  cmake -DELFELLI_GUI=ON . && make -j3
+  elfelli=./elfelli
 fi
+
+# Rendering needs no display, so the cairo output can be checked here.
+$elfelli --render bench/scenes -o ci-render
+$elfelli --render bench/scenes/dipole.elfelli -o ci-render/dipole.svg
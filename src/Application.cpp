@@ -121,6 +121,7 @@ void Application::on_export_png_activate()
 #ifdef DEBUG
       std::cerr << "Exporting PNG to file `" << filename << "'." << std::endl;
 #endif // DEBUG
+      sim_canvas.finish();
       sim_canvas.save(filename, "png");
     }
 
@@ -293,6 +294,23 @@ void Application::on_charge_value_changed()
   sim_canvas.set_selected_charge(charge_spin->get_value());
 }
 
+void Application::on_equipotentials_toggled()
+{
+  bool show = equipotentials_check->get_active();
+  spacing_scale->set_sensitive(show);
+  sim_canvas.set_equipotentials(show);
+}
+
+void Application::on_spacing_value_changed()
+{
+  sim_canvas.set_equipotential_spacing(spacing_scale->get_value());
+}
+
+void Application::on_heatmap_changed()
+{
+  sim_canvas.set_heatmap(static_cast<HeatmapType>(heatmap_combo->get_active_row_number()));
+}
+
 void Application::update_charge_spin()
 {
   float charge = sim_canvas.get_selected_charge();
@@ -478,6 +496,61 @@ Widget *Application::build_object_toolbar()
   return al;
 }
 
+Widget *Application::build_view_toolbar()
+{
+  Alignment *al = new Alignment(0.5, 0.5, 1.0, 0.0);
+  HBox *tb = new HBox;
+  al->add(*manage(tb));
+  al->set_padding(2, 2, 0, 0);
+
+  Tooltips *tips = manage(new Tooltips);
+
+  equipotentials_check = manage(new CheckButton(_("Equipotentials")));
+  equipotentials_check->unset_flags(CAN_FOCUS);
+  equipotentials_check->signal_toggled().connect(sigc::mem_fun(*this, &Application::on_equipotentials_toggled));
+  tips->set_tip(*equipotentials_check, _("Show lines of equal potential"));
+  tb->pack_start(*equipotentials_check, false, false);
+
+  HBox *spacing_box = manage(new HBox);
+  spacing_box->pack_start(*manage(new Label(_("Spacing:"))), false, false);
+
+  spacing_scale = manage(new HScale(0.002, 0.1, 0.002));
+  spacing_scale->set_digits(3);
+  spacing_scale->set_value(0.02);
+  spacing_scale->set_size_request(150, -1);
+  spacing_scale->unset_flags(CAN_FOCUS);
+  spacing_scale->signal_value_changed().connect(sigc::mem_fun(*this, &Application::on_spacing_value_changed));
+  spacing_scale->set_sensitive(false);
+  tips->set_tip(*spacing_scale, _("Change the difference in potential between neighbouring equipotentials"));
+  spacing_box->pack_start(*spacing_scale, false, false);
+
+  Alignment *spacing_al = manage(new Alignment);
+  spacing_al->add(*spacing_box);
+  spacing_al->set_padding(0, 0, 15, 0);
+  tb->pack_start(*spacing_al, false, false);
+
+
+  HBox *heatmap_box = manage(new HBox);
+  heatmap_box->pack_start(*manage(new Label(_("Background:"))), false, false);
+
+  /* In the order of HeatmapType */
+  heatmap_combo = manage(new ComboBoxText);
+  heatmap_combo->append_text(_("None"));
+  heatmap_combo->append_text(_("Field strength"));
+  heatmap_combo->append_text(_("Potential"));
+  heatmap_combo->set_active(HEATMAP_NONE);
+  heatmap_combo->unset_flags(CAN_FOCUS);
+  heatmap_combo->signal_changed().connect(sigc::mem_fun(*this, &Application::on_heatmap_changed));
+  heatmap_box->pack_start(*heatmap_combo, false, false);
+
+  Alignment *heatmap_al = manage(new Alignment);
+  heatmap_al->add(*heatmap_box);
+  heatmap_al->set_padding(0, 0, 15, 0);
+  tb->pack_start(*heatmap_al, false, false);
+
+  return al;
+}
+
 bool Application::build_gui()
 {
   VBox *vbox1 = manage(new VBox);
@@ -502,6 +575,10 @@ bool Application::build_gui()
   object_toolbox->add(*object_toolbar);
   vbox1->pack_start(*object_toolbox, false, false);
 
+  HandleBox *view_toolbox = manage(new HandleBox);
+  view_toolbox->add(*manage(build_view_toolbar()));
+  vbox1->pack_start(*view_toolbox, false, false);
+
   vbox1->pack_start(sim_canvas);
   sim_canvas.set_size_request(640, 480);
   sim_canvas.signal_selection_changed().connect(sigc::mem_fun(*this, &Application::on_sim_selection_changed));
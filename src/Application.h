@@ -61,6 +61,7 @@ private:
   void setup_gettext();
 
   Gtk::Widget *build_object_toolbar();
+  Gtk::Widget *build_view_toolbar();
   bool build_gui();
   bool setup_ui_actions();
   void setup_file_chooser_dialogs();
@@ -85,12 +86,18 @@ private:
   void on_sim_selection_changed();
   void on_sim_selected_charge_changed();
   void on_charge_value_changed();
+  void on_equipotentials_toggled();
+  void on_spacing_value_changed();
+  void on_heatmap_changed();
 
   Gtk::Main gtk_main;
   Gtk::Window main_win;
   Gtk::Statusbar sbar;
   Gtk::Widget *object_toolbar;
   Gtk::SpinButton *charge_spin;
+  Gtk::CheckButton *equipotentials_check;
+  Gtk::HScale *spacing_scale;
+  Gtk::ComboBoxText *heatmap_combo;
 
   Gtk::FileChooserDialog export_png_dlg, save_dlg, open_dlg;
   Gtk::FileFilter elfelli_xml, all;
@@ -0,0 +1,339 @@
+/*
+ * BatchRenderer.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "BatchRenderer.h"
+#include "Simulation.h"
+#include "XmlLoader.h"
+#include "Parallel.h"
+
+#include <glib.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <cairomm/context.h>
+#include <cairomm/surface.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <math.h>
+
+namespace Elfelli
+{
+
+/* Same sizes and colours as on the SimulationCanvas */
+static const double BODY_RADIUS = 10;
+static const double PLATE_WIDTH = 4;
+static const double NEGATIVE_RGB[] = {0, 0, 1};
+static const double POSITIVE_RGB[] = {1, 0, 0};
+
+static bool has_suffix(const std::string& s, const std::string& suffix)
+{
+  return s.size() >= suffix.size()
+    && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static double ms_since(const std::chrono::steady_clock::time_point& start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void draw_scene(const Simulation& sim, const Cairo::RefPtr<Cairo::Context>& cr)
+{
+  cr->set_source_rgb(1, 1, 1);
+  cr->paint();
+
+  const FluxLines& lines = sim.get_result();
+  cr->set_source_rgb(0, 0, 0);
+  cr->set_line_width(1);
+  cr->set_line_join(Cairo::LINE_JOIN_ROUND);
+  for(unsigned int i=0; i<lines.size(); ++i)
+    {
+      FluxLine l = lines[i];
+      if(l.size < 2)
+        continue;
+
+      cr->move_to(l[0].get_x(), l[0].get_y());
+      for(unsigned int j=1; j<l.size; ++j)
+        cr->line_to(l[j].get_x(), l[j].get_y());
+      cr->stroke();
+    }
+
+  const std::vector<PlateBody>& plates = sim.get_plates();
+  cr->set_line_width(PLATE_WIDTH);
+  cr->set_line_cap(Cairo::LINE_CAP_ROUND);
+  for(unsigned int i=0; i<plates.size(); ++i)
+    {
+      const double *rgb = plates[i].charge > 0 ? POSITIVE_RGB : NEGATIVE_RGB;
+      cr->set_source_rgb(rgb[0], rgb[1], rgb[2]);
+      cr->move_to(plates[i].pos_a.get_x(), plates[i].pos_a.get_y());
+      cr->line_to(plates[i].pos_b.get_x(), plates[i].pos_b.get_y());
+      cr->stroke();
+    }
+
+  const std::vector<Body>& bodies = sim.get_bodies();
+  cr->set_line_width(1);
+  for(unsigned int i=0; i<bodies.size(); ++i)
+    {
+      const double *rgb = bodies[i].charge > 0 ? POSITIVE_RGB : NEGATIVE_RGB;
+      cr->arc(bodies[i].pos.get_x(), bodies[i].pos.get_y(), BODY_RADIUS, 0, 2*M_PI);
+      cr->set_source_rgb(rgb[0], rgb[1], rgb[2]);
+      cr->fill_preserve();
+      cr->set_source_rgb(0, 0, 0);
+      cr->stroke();
+    }
+}
+
+BatchRenderer::BatchRenderer():
+  width(640), height(480), threads(0)
+{
+}
+
+/* Whether the program was started to render instead of showing the
+   window. */
+bool BatchRenderer::wanted(int argc, char **argv)
+{
+  for(int i=1; i<argc; ++i)
+    if(strcmp(argv[i], "--render") == 0)
+      return true;
+
+  return false;
+}
+
+int BatchRenderer::main(int argc, char **argv)
+{
+  BatchRenderer renderer;
+  if(!renderer.parse(argc, argv))
+    return 2;
+
+  return renderer.run();
+}
+
+void BatchRenderer::usage()
+{
+  std::cerr << "Usage: elfelli --render SCENE... [-o FILE|DIR] [--format png|svg]\n"
+            << "                [--width W] [--height H] [--threads N]\n"
+            << "SCENE is an .elfelli file or a directory of them." << std::endl;
+}
+
+bool BatchRenderer::parse(int argc, char **argv)
+{
+  for(int i=1; i<argc; ++i)
+    {
+      std::string arg = argv[i];
+      bool has_value = i + 1 < argc;
+
+      if(arg == "--render")
+        continue;
+      else if((arg == "-o" || arg == "--output") && has_value)
+        output = argv[++i];
+      else if(arg == "--format" && has_value)
+        format = argv[++i];
+      else if(arg == "--width" && has_value)
+        width = atoi(argv[++i]);
+      else if(arg == "--height" && has_value)
+        height = atoi(argv[++i]);
+      else if(arg == "--threads" && has_value)
+        {
+          if(!parse_threads(argv[++i], threads))
+            {
+              std::cerr << "Invalid thread count `" << argv[i] << "'." << std::endl;
+              usage();
+              return false;
+            }
+        }
+      else if(arg == "-h" || arg == "--help")
+        {
+          usage();
+          return false;
+        }
+      else if(arg.size() > 1 && arg[0] == '-')
+        {
+          std::cerr << "Unknown option `" << arg << "'." << std::endl;
+          usage();
+          return false;
+        }
+      else
+        add_input(arg);
+    }
+
+  if(inputs.empty() || width <= 0 || height <= 0
+     || !(format.empty() || format == "png" || format == "svg"))
+    {
+      usage();
+      return false;
+    }
+
+  return true;
+}
+
+void BatchRenderer::add_input(const std::string& path)
+{
+  if(!Glib::file_test(path, Glib::FILE_TEST_IS_DIR))
+    {
+      inputs.push_back(path);
+      return;
+    }
+
+  std::vector<std::string> found;
+  try
+    {
+      Glib::Dir dir(path);
+      for(Glib::Dir::iterator i=dir.begin(); i!=dir.end(); ++i)
+        if(has_suffix(*i, ".elfelli"))
+          found.push_back(Glib::build_filename(path, *i));
+    }
+  catch(const Glib::FileError& e)
+    {
+      std::cerr << "Could not read directory `" << path << "': " << e.what() << std::endl;
+    }
+
+  std::sort(found.begin(), found.end());
+  inputs.insert(inputs.end(), found.begin(), found.end());
+}
+
+/* A single scene is written to -o as it is; otherwise -o is the
+   directory for all of them. */
+std::string BatchRenderer::output_for(const std::string& input, bool single) const
+{
+  if(single && !output.empty() && !Glib::file_test(output, Glib::FILE_TEST_IS_DIR))
+    return output;
+
+  std::string name = Glib::path_get_basename(input);
+  if(has_suffix(name, ".elfelli"))
+    name.erase(name.size() - strlen(".elfelli"));
+  name += format == "svg" ? ".svg" : ".png";
+
+  if(output.empty())
+    return Glib::build_filename(Glib::path_get_dirname(input), name);
+  return Glib::build_filename(output, name);
+}
+
+void BatchRenderer::render(Job& job, unsigned int trace_threads) const
+{
+  job.ok = false;
+  job.bodies = job.plates = job.lines = job.points = 0;
+  job.load_ms = job.trace_ms = job.draw_ms = 0;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  Simulation sim;
+  XmlLoader loader;
+  if(loader.load(job.input.c_str(), &sim) != 0)
+    {
+      std::cerr << "Could not load `" << job.input << "'." << std::endl;
+      return;
+    }
+  job.bodies = sim.get_bodies().size();
+  job.plates = sim.get_plates().size();
+  job.load_ms = ms_since(start);
+
+  start = std::chrono::steady_clock::now();
+  TraceOptions opts;
+  opts.threads = trace_threads;
+  opts.view_x0 = opts.view_y0 = 0;
+  opts.view_x1 = width;
+  opts.view_y1 = height;
+  sim.set_options(opts);
+  sim.run();
+  job.lines = sim.get_result().size();
+  job.points = sim.get_result().n_points();
+  job.trace_ms = ms_since(start);
+
+  start = std::chrono::steady_clock::now();
+  bool svg = format.empty() ? has_suffix(job.output, ".svg") : format == "svg";
+  try
+    {
+      if(svg)
+        {
+          Cairo::RefPtr<Cairo::SvgSurface> surface = Cairo::SvgSurface::create(job.output, width, height);
+          Cairo::RefPtr<Cairo::Context> cr = Cairo::Context::create(surface);
+          draw_scene(sim, cr);
+          cr->show_page();
+          surface->finish();
+        }
+      else
+        {
+          Cairo::RefPtr<Cairo::ImageSurface> surface = Cairo::ImageSurface::create(Cairo::FORMAT_RGB24, width, height);
+          draw_scene(sim, Cairo::Context::create(surface));
+          surface->write_to_png(job.output);
+        }
+    }
+  catch(const std::exception& e)
+    {
+      std::cerr << "Could not write `" << job.output << "': " << e.what() << std::endl;
+      return;
+    }
+  job.draw_ms = ms_since(start);
+
+  job.ok = true;
+}
+
+int BatchRenderer::run()
+{
+  bool single = inputs.size() == 1;
+  if(!single && !output.empty())
+    g_mkdir_with_parents(output.c_str(), 0755);
+
+  jobs.resize(inputs.size());
+  for(unsigned int i=0; i<jobs.size(); ++i)
+    {
+      jobs[i].input = inputs[i];
+      jobs[i].output = output_for(inputs[i], single);
+    }
+
+  /* One scene uses all threads, many are traced one per thread. */
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  if(single)
+    render(jobs[0], threads);
+  else
+    parallel_for(jobs.size(), threads,
+                 [this](unsigned int i){render(jobs[i], 1);});
+  double wall_ms = ms_since(start);
+
+  unsigned int failed = 0;
+  double trace_ms = 0;
+  printf("%-32s %6s %6s %6s %8s %8s %9s %8s\n",
+         "scene", "bodies", "plates", "lines", "points", "load ms", "trace ms", "draw ms");
+  for(unsigned int i=0; i<jobs.size(); ++i)
+    {
+      const Job& job = jobs[i];
+      std::string name = Glib::path_get_basename(job.input);
+      if(!job.ok)
+        {
+          printf("%-32s failed\n", name.c_str());
+          failed++;
+          continue;
+        }
+
+      printf("%-32s %6u %6u %6u %8u %8.1f %9.1f %8.1f\n", name.c_str(),
+             job.bodies, job.plates, job.lines, job.points,
+             job.load_ms, job.trace_ms, job.draw_ms);
+      trace_ms += job.trace_ms;
+    }
+  printf("%u scenes, %u failed, %.1f ms tracing, %.1f ms in total\n",
+         static_cast<unsigned int>(jobs.size()), failed, trace_ms, wall_ms);
+
+  return failed ? 1 : 0;
+}
+
+}
@@ -0,0 +1,79 @@
+// -*- C++ -*-
+/*
+ * BatchRenderer.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _BATCH_RENDERER_H_
+#define _BATCH_RENDERER_H_
+
+#include <string>
+#include <vector>
+
+namespace Elfelli
+{
+
+/* Traces scene files and draws them into PNG or SVG files with cairo,
+   without a display or Gtk::Main:
+
+     elfelli --render SCENE... [-o FILE|DIR] [--format png|svg]
+             [--width W] [--height H] [--threads N]
+
+   A directory stands for all *.elfelli files in it.  Several scenes are
+   traced in parallel, one per thread, and -o then names the directory
+   the images go to; without -o every image is put next to its scene. */
+class BatchRenderer
+{
+public:
+  BatchRenderer();
+
+  /* Reads the command line; prints the usage and returns false if it
+     makes no sense. */
+  bool parse(int argc, char **argv);
+
+  /* Renders all scenes and prints how long each of them took; returns
+     the exit status of the program. */
+  int run();
+
+  static bool wanted(int argc, char **argv);
+  static int main(int argc, char **argv);
+
+private:
+  struct Job
+  {
+    std::string input, output;
+    bool ok;
+    unsigned int bodies, plates, lines, points;
+    double load_ms, trace_ms, draw_ms;
+  };
+
+  void add_input(const std::string& path);
+  std::string output_for(const std::string& input, bool single) const;
+  void render(Job& job, unsigned int trace_threads) const;
+  static void usage();
+
+  std::vector<std::string> inputs;
+  std::string output;
+  std::string format;   // "png" or "svg", empty to go by the file name
+  int width, height;
+  unsigned int threads;
+  std::vector<Job> jobs;
+};
+
+}
+
+#endif // _BATCH_RENDERER_H_
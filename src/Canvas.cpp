@@ -23,45 +23,6 @@
 namespace Elfelli
 {
 
-Path::Path()
-{
-}
-
-Path::Path(FluxLine l)
-{
-  for(unsigned int i=0; i < l.points.size(); ++i)
-  {
-    points.push_back(Gdk::Point(static_cast<int>(l.points[i].get_x()),
-                                static_cast<int>(l.points[i].get_y())));
-  }
-}
-
-Path::~Path()
-{
-}
-
-void Path::add(const Gdk::Point& point)
-{
-  points.push_back(point);
-}
-
-void Path::add(int x, int y)
-{
-  add(Gdk::Point(x, y));
-}
-
-void Path::clear()
-{
-  points.clear();
-}
-
-const std::vector<Gdk::Point> Path::get_points()
-{
-  return points;
-}
-
-
-
 Canvas::Canvas()
 {
   width = height = 0;
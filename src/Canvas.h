@@ -23,28 +23,9 @@
 
 #include <gtkmm/drawingarea.h>
 
-#include "Simulation.h"
-
 namespace Elfelli
 {
 
-class Path
-{
-public:
-  Path();
-  Path(FluxLine l);
-  ~Path();
-
-  void add(const Gdk::Point& point);
-  void add(int x, int y);
-  void clear();
-  const std::vector<Gdk::Point> get_points();
-
-private:
-  std::vector<Gdk::Point> points;
-
-};
-
 struct CanvasBody
 {
   int num;
@@ -0,0 +1,149 @@
+/*
+ * CaptureGrid.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "CaptureGrid.h"
+#include "Simulation.h"
+
+namespace Elfelli
+{
+
+const float CaptureGrid::MIN_CELL_SIZE(8);
+const unsigned int CaptureGrid::MAX_CELLS(1 << 20);
+
+CaptureGrid::CaptureGrid():
+  x0(0), y0(0), cell(1), nx(0), ny(0)
+{
+}
+
+void CaptureGrid::clear()
+{
+  body_start.clear();
+  body_items.clear();
+  plate_start.clear();
+  plate_items.clear();
+  nx = ny = 0;
+}
+
+void CaptureGrid::build(const std::vector<Body>& bodies, const std::vector<PlateBody>& plates,
+                        float body_radius, float plate_radius)
+{
+  clear();
+
+  unsigned int n = bodies.size() + plates.size();
+  if(n == 0)
+    return;
+
+  float x1, y1;
+  x0 = y0 = 1e30;
+  x1 = y1 = -1e30;
+  for(unsigned int i=0; i<bodies.size(); ++i)
+  {
+    x0 = fmin(x0, bodies[i].pos.get_x() - body_radius);
+    y0 = fmin(y0, bodies[i].pos.get_y() - body_radius);
+    x1 = fmax(x1, bodies[i].pos.get_x() + body_radius);
+    y1 = fmax(y1, bodies[i].pos.get_y() + body_radius);
+  }
+  for(unsigned int i=0; i<plates.size(); ++i)
+  {
+    const PlateBody& pl = plates[i];
+    x0 = fmin(x0, fmin(pl.pos_a.get_x(), pl.pos_b.get_x()) - plate_radius);
+    y0 = fmin(y0, fmin(pl.pos_a.get_y(), pl.pos_b.get_y()) - plate_radius);
+    x1 = fmax(x1, fmax(pl.pos_a.get_x(), pl.pos_b.get_x()) + plate_radius);
+    y1 = fmax(y1, fmax(pl.pos_a.get_y(), pl.pos_b.get_y()) + plate_radius);
+  }
+  if(!(x1 > x0 && y1 > y0))
+    return;
+
+  /* About one object per cell, but never so many cells that building
+     the grid costs more than it saves. */
+  cell = fmax(MIN_CELL_SIZE, sqrt((x1 - x0)*(y1 - y0)/n));
+  while(ceil((x1 - x0)/cell)*ceil((y1 - y0)/cell) > MAX_CELLS)
+    cell *= 2;
+  nx = static_cast<unsigned int>(ceil((x1 - x0)/cell));
+  ny = static_cast<unsigned int>(ceil((y1 - y0)/cell));
+
+  /* An object goes into every cell whose centre is closer to it than
+     its radius plus half a cell diagonal, which includes every cell
+     that has a point within the radius. */
+  const float slack = 0.5*cell*1.4143 + 0.001*cell;
+
+  std::vector<unsigned int> cells, owners;
+
+  for(unsigned int b=0; b<bodies.size(); ++b)
+  {
+    float px = bodies[b].pos.get_x(), py = bodies[b].pos.get_y();
+    float r = body_radius + slack;
+    unsigned int i0, i1, j0, j1;
+    if(!cell_range(px - r, px + r, x0, nx, i0, i1) || !cell_range(py - r, py + r, y0, ny, j0, j1))
+      continue;
+    for(unsigned int j=j0; j<=j1; ++j)
+      for(unsigned int i=i0; i<=i1; ++i)
+      {
+        float cx = x0 + (i + 0.5f)*cell - px, cy = y0 + (j + 0.5f)*cell - py;
+        if(cx*cx + cy*cy <= r*r)
+        {
+          cells.push_back(j*nx + i);
+          owners.push_back(b);
+        }
+      }
+  }
+  fill(cells, owners, body_start, body_items);
+
+  cells.clear();
+  owners.clear();
+  for(unsigned int p=0; p<plates.size(); ++p)
+  {
+    const PlateBody& pl = plates[p];
+    float ax = pl.pos_a.get_x(), ay = pl.pos_a.get_y();
+    float bx = pl.pos_b.get_x(), by = pl.pos_b.get_y();
+    float r = plate_radius + slack;
+    unsigned int i0, i1, j0, j1;
+    if(!cell_range(fmin(ax, bx) - r, fmax(ax, bx) + r, x0, nx, i0, i1)
+       || !cell_range(fmin(ay, by) - r, fmax(ay, by) + r, y0, ny, j0, j1))
+      continue;
+    for(unsigned int j=j0; j<=j1; ++j)
+      for(unsigned int i=i0; i<=i1; ++i)
+      {
+        if(segment_distance2(x0 + (i + 0.5f)*cell, y0 + (j + 0.5f)*cell, ax, ay, bx, by) <= r*r)
+        {
+          cells.push_back(j*nx + i);
+          owners.push_back(p);
+        }
+      }
+  }
+  fill(cells, owners, plate_start, plate_items);
+}
+
+/* Sorts the (cell, object) pairs into the compressed per-cell lists. */
+void CaptureGrid::fill(const std::vector<unsigned int>& cells, const std::vector<unsigned int>& owners,
+                       std::vector<unsigned int>& start, std::vector<unsigned int>& items) const
+{
+  start.assign(nx*ny + 1, 0);
+  for(unsigned int k=0; k<cells.size(); ++k)
+    start[cells[k] + 1]++;
+  for(unsigned int c=0; c<nx*ny; ++c)
+    start[c + 1] += start[c];
+
+  std::vector<unsigned int> next(start.begin(), start.end() - 1);
+  items.resize(cells.size());
+  for(unsigned int k=0; k<cells.size(); ++k)
+    items[next[cells[k]]++] = owners[k];
+}
+
+}
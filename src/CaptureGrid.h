@@ -0,0 +1,141 @@
+// -*- C++ -*-
+/*
+ * CaptureGrid.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _CAPTURE_GRID_H_
+#define _CAPTURE_GRID_H_
+
+#include <vector>
+#include <math.h>
+
+namespace Elfelli
+{
+
+struct Body;
+struct PlateBody;
+
+/* Uniform grid over the bodies and plates, used to find the few objects
+   a flux line can run into at its current position.  Every object is
+   listed in all cells that come closer to it than its capture radius,
+   so only the cells the line actually touches have to be looked at. */
+class CaptureGrid
+{
+public:
+  CaptureGrid();
+
+  void build(const std::vector<Body>& bodies, const std::vector<PlateBody>& plates,
+             float body_radius, float plate_radius);
+  void clear();
+  bool empty() const{return body_start.empty();};
+
+  /* Calls `body' and `plate' with the index of every object that may be
+     within its capture radius of the segment (ax,ay)-(bx,by), which may
+     also be a single point.  An object can be reported more than once.
+     Stops and returns true as soon as one of the calls returns true. */
+  template<class BodyFunc, class PlateFunc>
+  bool find(float ax, float ay, float bx, float by,
+            BodyFunc body, PlateFunc plate) const;
+
+  static const float MIN_CELL_SIZE;
+  static const unsigned int MAX_CELLS;
+
+private:
+  static float segment_distance2(float px, float py,
+                                 float ax, float ay, float bx, float by);
+  bool cell_range(float lo, float hi, float origin, unsigned int n,
+                  unsigned int& first, unsigned int& last) const;
+  void fill(const std::vector<unsigned int>& cells, const std::vector<unsigned int>& owners,
+            std::vector<unsigned int>& start, std::vector<unsigned int>& items) const;
+
+  float x0, y0, cell;
+  unsigned int nx, ny;
+
+  /* Objects of cell c are items[start[c]] to items[start[c+1]-1]. */
+  std::vector<unsigned int> body_start, body_items;
+  std::vector<unsigned int> plate_start, plate_items;
+};
+
+inline float CaptureGrid::segment_distance2(float px, float py,
+                                            float ax, float ay, float bx, float by)
+{
+  float dx = bx - ax, dy = by - ay;
+  px -= ax;
+  py -= ay;
+  float l2 = dx*dx + dy*dy;
+  float u = 0;
+  if(l2 > 0)
+    u = fmax(0.0f, fmin(1.0f, (px*dx + py*dy)/l2));
+  px -= u*dx;
+  py -= u*dy;
+  return px*px + py*py;
+}
+
+inline bool CaptureGrid::cell_range(float lo, float hi, float origin, unsigned int n,
+                                    unsigned int& first, unsigned int& last) const
+{
+  float a = floor((lo - origin)/cell);
+  float b = floor((hi - origin)/cell);
+  if(!(b >= 0 && a < n))
+    return false;
+
+  first = (a > 0) ? static_cast<unsigned int>(a) : 0;
+  last = (b < n - 1) ? static_cast<unsigned int>(b) : n - 1;
+  return true;
+}
+
+template<class BodyFunc, class PlateFunc>
+bool CaptureGrid::find(float ax, float ay, float bx, float by,
+                       BodyFunc body, PlateFunc plate) const
+{
+  if(empty())
+    return false;
+
+  unsigned int i0, i1, j0, j1;
+  if(!cell_range(fmin(ax, bx), fmax(ax, bx), x0, nx, i0, i1)
+     || !cell_range(fmin(ay, by), fmax(ay, by), y0, ny, j0, j1))
+    return false;
+
+  /* A diagonal segment crosses only some of the cells of its bounding
+     box; skip those whose centre is farther away than half a
+     diagonal. */
+  const bool single = (i0 == i1 && j0 == j1);
+  const float reach = 0.5*cell*1.4143;
+
+  for(unsigned int j=j0; j<=j1; ++j)
+    for(unsigned int i=i0; i<=i1; ++i)
+    {
+      if(!single && segment_distance2(x0 + (i + 0.5f)*cell, y0 + (j + 0.5f)*cell,
+                                      ax, ay, bx, by) > reach*reach)
+        continue;
+
+      unsigned int c = j*nx + i;
+      for(unsigned int k=body_start[c]; k<body_start[c+1]; ++k)
+        if(body(body_items[k]))
+          return true;
+      for(unsigned int k=plate_start[c]; k<plate_start[c+1]; ++k)
+        if(plate(plate_items[k]))
+          return true;
+    }
+
+  return false;
+}
+
+}
+
+#endif // _CAPTURE_GRID_H_
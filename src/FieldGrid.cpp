@@ -0,0 +1,169 @@
+/*
+ * FieldGrid.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "FieldGrid.h"
+#include "Parallel.h"
+#include "Simulation.h"
+
+#include <math.h>
+
+namespace Elfelli
+{
+
+const float FieldGrid::TILE_SIZE(32);
+
+/* Distance from p to the segment a-b. */
+static float segment_distance(const Vec2& p, const Vec2& a, const Vec2& b)
+{
+  Vec2 d = b - a;
+  float l2 = d.get_x()*d.get_x() + d.get_y()*d.get_y();
+  float u = 0;
+  if(l2 > 0)
+    u = ((p.get_x()-a.get_x())*d.get_x() + (p.get_y()-a.get_y())*d.get_y())/l2;
+  u = fmax(0.0f, fmin(1.0f, u));
+
+  return p.distance(a + d*u);
+}
+
+FieldGrid::FieldGrid():
+  x0(0), y0(0), nx(0), ny(0)
+{
+}
+
+void FieldGrid::clear()
+{
+  tiles.clear();
+  samples.clear();
+  nx = ny = 0;
+}
+
+void FieldGrid::build(float left, float top, float right, float bottom,
+                      const std::vector<Vec2>& points, const std::vector<Vec2>& segments,
+                      float exact_radius, unsigned int threads, const FieldFunc& field)
+{
+  clear();
+
+  x0 = left;
+  y0 = top;
+  nx = static_cast<unsigned int>(ceil((right - left)/TILE_SIZE));
+  ny = static_cast<unsigned int>(ceil((bottom - top)/TILE_SIZE));
+  if(nx == 0 || ny == 0)
+    return;
+
+  tiles.resize(nx*ny);
+
+  /* Pick the resolution of every tile from the distance of its nearest
+     source: the field changes fastest close to the charges. */
+  const float half_diagonal = TILE_SIZE*0.7072;
+  int offset = 0;
+  for(unsigned int ty=0; ty<ny; ++ty)
+    for(unsigned int tx=0; tx<nx; ++tx)
+    {
+      Vec2 centre(x0 + (tx + 0.5)*TILE_SIZE, y0 + (ty + 0.5)*TILE_SIZE);
+
+      float dist = 1e30;
+      for(unsigned int i=0; i<points.size(); ++i)
+        dist = fmin(dist, centre.distance(points[i]));
+      for(unsigned int i=0; i+1<segments.size(); i+=2)
+        dist = fmin(dist, segment_distance(centre, segments[i], segments[i+1]));
+      dist -= half_diagonal;
+
+      Tile& tile = tiles[ty*nx + tx];
+      if(dist < exact_radius)
+      {
+        tile.offset = -1;
+        tile.res = 0;
+        continue;
+      }
+
+      if(dist < 2*TILE_SIZE)
+        tile.res = 16;
+      else if(dist < 6*TILE_SIZE)
+        tile.res = 8;
+      else
+        tile.res = 4;
+
+      tile.offset = offset;
+      offset += 2*(tile.res + 1)*(tile.res + 1);
+    }
+
+  samples.resize(offset);
+
+  parallel_for(tiles.size(), threads,
+               [&](unsigned int t)
+               {
+                 const Tile& tile = tiles[t];
+                 if(tile.offset < 0)
+                   return;
+
+                 float tx0 = x0 + (t % nx)*TILE_SIZE;
+                 float ty0 = y0 + (t / nx)*TILE_SIZE;
+                 float spacing = TILE_SIZE/tile.res;
+                 float *out = &samples[tile.offset];
+                 for(unsigned int j=0; j<=tile.res; ++j)
+                   for(unsigned int i=0; i<=tile.res; ++i)
+                   {
+                     Vec2 f = field(Vec2(tx0 + i*spacing, ty0 + j*spacing));
+                     *out++ = f.get_x();
+                     *out++ = f.get_y();
+                   }
+               });
+}
+
+bool FieldGrid::sample(float x, float y, float& fx, float& fy) const
+{
+  float gx = (x - x0)/TILE_SIZE;
+  float gy = (y - y0)/TILE_SIZE;
+  if(!(gx >= 0 && gy >= 0))
+    return false;
+
+  unsigned int tx = static_cast<unsigned int>(gx);
+  unsigned int ty = static_cast<unsigned int>(gy);
+  if(tx >= nx || ty >= ny)
+    return false;
+
+  const Tile& tile = tiles[ty*nx + tx];
+  if(tile.offset < 0)
+    return false;
+
+  float u = (gx - tx)*tile.res;
+  float v = (gy - ty)*tile.res;
+  unsigned int i = static_cast<unsigned int>(u);
+  unsigned int j = static_cast<unsigned int>(v);
+  if(i >= tile.res)
+    i = tile.res - 1;
+  if(j >= tile.res)
+    j = tile.res - 1;
+  u -= i;
+  v -= j;
+
+  const unsigned int row = tile.res + 1;
+  const float *s00 = &samples[tile.offset + 2*(j*row + i)];
+  const float *s10 = s00 + 2;
+  const float *s01 = s00 + 2*row;
+  const float *s11 = s01 + 2;
+
+  float w00 = (1-u)*(1-v), w10 = u*(1-v), w01 = (1-u)*v, w11 = u*v;
+  fx = w00*s00[0] + w10*s10[0] + w01*s01[0] + w11*s11[0];
+  fy = w00*s00[1] + w10*s10[1] + w01*s01[1] + w11*s11[1];
+
+  return true;
+}
+
+}
@@ -0,0 +1,73 @@
+// -*- C++ -*-
+/*
+ * FieldGrid.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _FIELD_GRID_H_
+#define _FIELD_GRID_H_
+
+#include <vector>
+#include <functional>
+
+namespace Elfelli
+{
+
+class Vec2;
+
+/* Precomputed field vectors over a rectangle, sampled with bilinear
+   interpolation.  The rectangle is split into square tiles whose
+   resolution depends on the distance to the nearest source; tiles
+   closer than the exact radius to a source store nothing and make
+   sample() fail, so the caller evaluates the field directly there. */
+class FieldGrid
+{
+public:
+  FieldGrid();
+
+  typedef std::function<Vec2(const Vec2&)> FieldFunc;
+
+  /* `points' and `segments' (pairs of end points) describe where the
+     sources are, `field' returns the field of a unit charge. */
+  void build(float left, float top, float right, float bottom,
+             const std::vector<Vec2>& points, const std::vector<Vec2>& segments,
+             float exact_radius, unsigned int threads, const FieldFunc& field);
+  void clear();
+  bool empty() const{return tiles.empty();};
+
+  bool sample(float x, float y, float& fx, float& fy) const;
+
+  unsigned int n_samples() const{return samples.size()/2;};
+
+  static const float TILE_SIZE;
+
+private:
+  struct Tile
+  {
+    int offset;         // first sample, -1 if the field is evaluated exactly
+    unsigned int res;   // cells per tile edge
+  };
+
+  float x0, y0;
+  unsigned int nx, ny;
+  std::vector<Tile> tiles;
+  std::vector<float> samples;
+};
+
+}
+
+#endif // _FIELD_GRID_H_
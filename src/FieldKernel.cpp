@@ -0,0 +1,500 @@
+/*
+ * FieldKernel.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "FieldKernel.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace Elfelli
+{
+
+typedef void (*BodyFieldFunc)(const BodyArrays&, float, float, float&, float&);
+typedef float (*BodyPotentialFunc)(const BodyArrays&, float, float);
+
+/* Handles bodies [first, size) one at a time; used by every kernel for
+   the elements that do not fill a whole vector. */
+static inline void body_field_tail(const BodyArrays& b, unsigned int first,
+                                   float px, float py, float& fx, float& fy)
+{
+  for(unsigned int i=first; i<b.size(); ++i)
+  {
+    float dx = px - b.x[i];
+    float dy = py - b.y[i];
+    float r2 = dx*dx + dy*dy;
+    float inv = 1/sqrt(r2);
+    float w = b.charge[i]*inv*inv*inv;
+
+    fx += w*dx;
+    fy += w*dy;
+  }
+}
+
+static void body_field_scalar(const BodyArrays& b, float px, float py, float& fx, float& fy)
+{
+  fx = fy = 0;
+  body_field_tail(b, 0, px, py, fx, fy);
+}
+
+static inline float body_potential_tail(const BodyArrays& b, unsigned int first, float px, float py)
+{
+  float u = 0;
+  for(unsigned int i=first; i<b.size(); ++i)
+  {
+    float dx = px - b.x[i];
+    float dy = py - b.y[i];
+    u += b.charge[i]/sqrt(dx*dx + dy*dy);
+  }
+  return u;
+}
+
+static float body_potential_scalar(const BodyArrays& b, float px, float py)
+{
+  return body_potential_tail(b, 0, px, py);
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/* All vector kernels use the hardware reciprocal square root estimate
+   refined by one Newton-Raphson step, inv' = inv*(1.5 - 0.5*r2*inv^2),
+   which is accurate to about one ulp of float. */
+
+static void body_field_sse2(const BodyArrays& b, float px, float py, float& fx, float& fy)
+{
+  const unsigned int n = b.size() & ~3u;
+  const __m128 vpx = _mm_set1_ps(px), vpy = _mm_set1_ps(py);
+  const __m128 half = _mm_set1_ps(0.5f), three_halves = _mm_set1_ps(1.5f);
+  __m128 ax = _mm_setzero_ps(), ay = _mm_setzero_ps();
+
+  for(unsigned int i=0; i<n; i+=4)
+  {
+    __m128 dx = _mm_sub_ps(vpx, _mm_loadu_ps(&b.x[i]));
+    __m128 dy = _mm_sub_ps(vpy, _mm_loadu_ps(&b.y[i]));
+    __m128 r2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+
+    __m128 inv = _mm_rsqrt_ps(r2);
+    inv = _mm_mul_ps(inv, _mm_sub_ps(three_halves, _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(inv, inv))));
+
+    __m128 w = _mm_mul_ps(_mm_loadu_ps(&b.charge[i]), _mm_mul_ps(inv, _mm_mul_ps(inv, inv)));
+    ax = _mm_add_ps(ax, _mm_mul_ps(w, dx));
+    ay = _mm_add_ps(ay, _mm_mul_ps(w, dy));
+  }
+
+  float sx[4], sy[4];
+  _mm_storeu_ps(sx, ax);
+  _mm_storeu_ps(sy, ay);
+  fx = (sx[0] + sx[1]) + (sx[2] + sx[3]);
+  fy = (sy[0] + sy[1]) + (sy[2] + sy[3]);
+
+  body_field_tail(b, n, px, py, fx, fy);
+}
+
+static float body_potential_sse2(const BodyArrays& b, float px, float py)
+{
+  const unsigned int n = b.size() & ~3u;
+  const __m128 vpx = _mm_set1_ps(px), vpy = _mm_set1_ps(py);
+  const __m128 half = _mm_set1_ps(0.5f), three_halves = _mm_set1_ps(1.5f);
+  __m128 acc = _mm_setzero_ps();
+
+  for(unsigned int i=0; i<n; i+=4)
+  {
+    __m128 dx = _mm_sub_ps(vpx, _mm_loadu_ps(&b.x[i]));
+    __m128 dy = _mm_sub_ps(vpy, _mm_loadu_ps(&b.y[i]));
+    __m128 r2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+
+    __m128 inv = _mm_rsqrt_ps(r2);
+    inv = _mm_mul_ps(inv, _mm_sub_ps(three_halves, _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(inv, inv))));
+
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&b.charge[i]), inv));
+  }
+
+  float s[4];
+  _mm_storeu_ps(s, acc);
+  return (s[0] + s[1]) + (s[2] + s[3]) + body_potential_tail(b, n, px, py);
+}
+
+__attribute__((target("avx2,fma")))
+static void body_field_avx2(const BodyArrays& b, float px, float py, float& fx, float& fy)
+{
+  const unsigned int n = b.size() & ~7u;
+  const __m256 vpx = _mm256_set1_ps(px), vpy = _mm256_set1_ps(py);
+  const __m256 half = _mm256_set1_ps(0.5f), three_halves = _mm256_set1_ps(1.5f);
+  __m256 ax = _mm256_setzero_ps(), ay = _mm256_setzero_ps();
+
+  for(unsigned int i=0; i<n; i+=8)
+  {
+    __m256 dx = _mm256_sub_ps(vpx, _mm256_loadu_ps(&b.x[i]));
+    __m256 dy = _mm256_sub_ps(vpy, _mm256_loadu_ps(&b.y[i]));
+    __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy));
+
+    __m256 inv = _mm256_rsqrt_ps(r2);
+    inv = _mm256_mul_ps(inv, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(inv, inv), three_halves));
+
+    __m256 w = _mm256_mul_ps(_mm256_loadu_ps(&b.charge[i]), _mm256_mul_ps(inv, _mm256_mul_ps(inv, inv)));
+    ax = _mm256_fmadd_ps(w, dx, ax);
+    ay = _mm256_fmadd_ps(w, dy, ay);
+  }
+
+  __m128 sx = _mm_add_ps(_mm256_castps256_ps128(ax), _mm256_extractf128_ps(ax, 1));
+  __m128 sy = _mm_add_ps(_mm256_castps256_ps128(ay), _mm256_extractf128_ps(ay, 1));
+  float tx[4], ty[4];
+  _mm_storeu_ps(tx, sx);
+  _mm_storeu_ps(ty, sy);
+  fx = (tx[0] + tx[1]) + (tx[2] + tx[3]);
+  fy = (ty[0] + ty[1]) + (ty[2] + ty[3]);
+
+  body_field_tail(b, n, px, py, fx, fy);
+}
+
+__attribute__((target("avx2,fma")))
+static float body_potential_avx2(const BodyArrays& b, float px, float py)
+{
+  const unsigned int n = b.size() & ~7u;
+  const __m256 vpx = _mm256_set1_ps(px), vpy = _mm256_set1_ps(py);
+  const __m256 half = _mm256_set1_ps(0.5f), three_halves = _mm256_set1_ps(1.5f);
+  __m256 acc = _mm256_setzero_ps();
+
+  for(unsigned int i=0; i<n; i+=8)
+  {
+    __m256 dx = _mm256_sub_ps(vpx, _mm256_loadu_ps(&b.x[i]));
+    __m256 dy = _mm256_sub_ps(vpy, _mm256_loadu_ps(&b.y[i]));
+    __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy));
+
+    __m256 inv = _mm256_rsqrt_ps(r2);
+    inv = _mm256_mul_ps(inv, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(inv, inv), three_halves));
+
+    acc = _mm256_fmadd_ps(_mm256_loadu_ps(&b.charge[i]), inv, acc);
+  }
+
+  __m128 s4 = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  float s[4];
+  _mm_storeu_ps(s, s4);
+  return (s[0] + s[1]) + (s[2] + s[3]) + body_potential_tail(b, n, px, py);
+}
+
+__attribute__((target("avx512f")))
+static void body_field_avx512(const BodyArrays& b, float px, float py, float& fx, float& fy)
+{
+  const unsigned int n = b.size() & ~15u;
+  const __m512 vpx = _mm512_set1_ps(px), vpy = _mm512_set1_ps(py);
+  const __m512 half = _mm512_set1_ps(0.5f), three_halves = _mm512_set1_ps(1.5f);
+  __m512 ax = _mm512_setzero_ps(), ay = _mm512_setzero_ps();
+
+  for(unsigned int i=0; i<n; i+=16)
+  {
+    __m512 dx = _mm512_sub_ps(vpx, _mm512_loadu_ps(&b.x[i]));
+    __m512 dy = _mm512_sub_ps(vpy, _mm512_loadu_ps(&b.y[i]));
+    __m512 r2 = _mm512_fmadd_ps(dx, dx, _mm512_mul_ps(dy, dy));
+
+    __m512 inv = _mm512_maskz_rsqrt14_ps(0xffff, r2);
+    inv = _mm512_mul_ps(inv, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(inv, inv), three_halves));
+
+    __m512 w = _mm512_mul_ps(_mm512_loadu_ps(&b.charge[i]), _mm512_mul_ps(inv, _mm512_mul_ps(inv, inv)));
+    ax = _mm512_fmadd_ps(w, dx, ax);
+    ay = _mm512_fmadd_ps(w, dy, ay);
+  }
+
+  float sx[16], sy[16];
+  _mm512_storeu_ps(sx, ax);
+  _mm512_storeu_ps(sy, ay);
+  fx = fy = 0;
+  for(int k=0; k<16; ++k)
+  {
+    fx += sx[k];
+    fy += sy[k];
+  }
+
+  body_field_tail(b, n, px, py, fx, fy);
+}
+
+__attribute__((target("avx512f")))
+static float body_potential_avx512(const BodyArrays& b, float px, float py)
+{
+  const unsigned int n = b.size() & ~15u;
+  const __m512 vpx = _mm512_set1_ps(px), vpy = _mm512_set1_ps(py);
+  const __m512 half = _mm512_set1_ps(0.5f), three_halves = _mm512_set1_ps(1.5f);
+  __m512 acc = _mm512_setzero_ps();
+
+  for(unsigned int i=0; i<n; i+=16)
+  {
+    __m512 dx = _mm512_sub_ps(vpx, _mm512_loadu_ps(&b.x[i]));
+    __m512 dy = _mm512_sub_ps(vpy, _mm512_loadu_ps(&b.y[i]));
+    __m512 r2 = _mm512_fmadd_ps(dx, dx, _mm512_mul_ps(dy, dy));
+
+    __m512 inv = _mm512_maskz_rsqrt14_ps(0xffff, r2);
+    inv = _mm512_mul_ps(inv, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(inv, inv), three_halves));
+
+    acc = _mm512_fmadd_ps(_mm512_loadu_ps(&b.charge[i]), inv, acc);
+  }
+
+  float s[16];
+  _mm512_storeu_ps(s, acc);
+  float u = 0;
+  for(int k=0; k<16; ++k)
+    u += s[k];
+
+  return u + body_potential_tail(b, n, px, py);
+}
+
+#endif // HAVE_X86_KERNELS
+
+/* Number of bodies from which body_field() and body_potential() use
+   the kernel picked for the CPU */
+static const unsigned int SMALL_SCENE = 32;
+
+struct BodyFieldImpl
+{
+  BodyFieldFunc func;
+  BodyPotentialFunc potential;
+  const char *name;
+};
+
+static BodyFieldImpl select_body_field()
+{
+  BodyFieldImpl impl = {body_field_scalar, body_potential_scalar, "scalar"};
+
+#ifdef HAVE_X86_KERNELS
+  __builtin_cpu_init();
+
+  impl.func = body_field_sse2;
+  impl.potential = body_potential_sse2;
+  impl.name = "sse2";
+
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+  {
+    impl.func = body_field_avx2;
+    impl.potential = body_potential_avx2;
+    impl.name = "avx2";
+  }
+  if(__builtin_cpu_supports("avx512f"))
+  {
+    impl.func = body_field_avx512;
+    impl.potential = body_potential_avx512;
+    impl.name = "avx512";
+  }
+#endif // HAVE_X86_KERNELS
+
+  return impl;
+}
+
+static const BodyFieldImpl& body_field_impl()
+{
+  static const BodyFieldImpl impl = select_body_field();
+  return impl;
+}
+
+void body_field(const BodyArrays& b, float px, float py, float& fx, float& fy)
+{
+  /* A few bodies fill no wide vector and would all go through the
+     tail after an indirect call; SSE2 is always there and faster up
+     to about two AVX-512 vectors' worth. */
+  if(b.size() < SMALL_SCENE)
+    {
+#ifdef HAVE_X86_KERNELS
+      body_field_sse2(b, px, py, fx, fy);
+#else
+      body_field_scalar(b, px, py, fx, fy);
+#endif
+      return;
+    }
+
+  body_field_impl().func(b, px, py, fx, fy);
+}
+
+float body_potential(const BodyArrays& b, float px, float py)
+{
+  if(b.size() < SMALL_SCENE)
+#ifdef HAVE_X86_KERNELS
+    return body_potential_sse2(b, px, py);
+#else
+    return body_potential_scalar(b, px, py);
+#endif
+
+  return body_field_impl().potential(b, px, py);
+}
+
+const char *body_field_isa()
+{
+  return body_field_impl().name;
+}
+
+/* Polynomial arctangent of z in [0, 1], Abramowitz and Stegun 4.4.49;
+   the absolute error stays below 2e-8. */
+static inline float atan_unit(float z)
+{
+  float z2 = z*z;
+  return z*(0.9999993329f + z2*(-0.3332985605f + z2*(0.1994653599f + z2*(-0.1390853351f
+            + z2*(0.0964200441f + z2*(-0.0559098861f + z2*(0.0218612288f + z2*(-0.0040540580f))))))));
+}
+
+/* atan2(y, x) for y >= 0. */
+static inline float fast_atan2(float y, float x)
+{
+  float ax = fabs(x);
+  float a;
+  if(y <= ax)
+    a = (ax > 0) ? atan_unit(y/ax) : 0;
+  else
+    a = 1.5707963268f - atan_unit(ax/y);
+
+  return (x < 0) ? 3.1415926536f - a : a;
+}
+
+/* Natural logarithm of a positive, finite x: x = m*2^e with m in
+   [sqrt(1/2), sqrt(2)), and ln(m) = 2 atanh(s) with s = (m-1)/(m+1),
+   |s| < 0.172, from the series up to s^7 (error below 4e-8). */
+static inline float fast_log(float x)
+{
+  unsigned int bits;
+  memcpy(&bits, &x, sizeof(bits));
+  int e = static_cast<int>((bits >> 23) & 0xff) - 127;
+  bits = (bits & 0x007fffff) | 0x3f800000;
+  float m;
+  memcpy(&m, &bits, sizeof(m));
+  if(m > 1.4142135624f)
+  {
+    m *= 0.5f;
+    e++;
+  }
+
+  float s = (m - 1)/(m + 1);
+  float s2 = s*s;
+  return e*0.6931471806f + 2*s*(1 + s2*(1.0f/3 + s2*(1.0f/5 + s2*(1.0f/7))));
+}
+
+void PlateFrame::set(float ax, float ay, float bx, float by, float q)
+{
+  this->ax = ax;
+  this->ay = ay;
+  length = sqrt((bx - ax)*(bx - ax) + (by - ay)*(by - ay));
+  if(length > 0)
+  {
+    dx = (bx - ax)/length;
+    dy = (by - ay)/length;
+    charge = q*30/length;
+  }
+  else
+  {
+    dx = 1;
+    dy = 0;
+    charge = 0;
+  }
+  nx = dy;
+  ny = -dx;
+}
+
+/* Seen from the point, the plate reaches from t0 to t1 = t0 + length
+   along its direction, at the signed distance h across it.  The field
+   is that of the plate's charge placed at the point w along the plate
+   from the foot of the perpendicular, where
+
+     w = |h| ln(r1/r0) / alpha,
+
+   r0 and r1 are the distances of the end points and alpha is the angle
+   under which the plate is seen.  For h -> 0 outside the plate,
+   |h|/alpha tends to t0 t1 / length, which is also used for small
+   angles so the collinear case needs no division by h. */
+template<bool FAST>
+static inline void plate_field_impl(const PlateFrame& p, float px, float py, float& fx, float& fy)
+{
+  float rx = p.ax - px;
+  float ry = p.ay - py;
+  float t0 = rx*p.dx + ry*p.dy;
+  float h = rx*p.nx + ry*p.ny;
+  float t1 = t0 + p.length;
+
+  float h2 = h*h;
+  float r02 = t0*t0 + h2;
+  float r12 = t1*t1 + h2;
+  if(!(r02 > 0 && r12 > 0))
+    return;
+
+  float y = p.length*fabs(h);
+  float x = h2 + t0*t1;
+  float k;
+  if(y < 1e-3f*fabs(x) && x > 0)
+    k = x/p.length;
+  else
+  {
+    float alpha = FAST ? fast_atan2(y, x) : atan2(y, x);
+    k = fabs(h)/alpha;
+  }
+
+  float w = 0.5f*k*(FAST ? fast_log(r12/r02) : log(r12/r02));
+
+  /* Vector from the point to the effective charge */
+  float vx = h*p.nx + w*p.dx;
+  float vy = h*p.ny + w*p.dy;
+  float d2 = h2 + w*w;
+  if(!(d2 > 0))
+    return;
+
+  float s = p.charge/(d2*sqrt(d2));
+  fx -= vx*s;
+  fy -= vy*s;
+}
+
+void plate_field(const PlateFrame& p, float px, float py, float& fx, float& fy)
+{
+  plate_field_impl<false>(p, px, py, fx, fy);
+}
+
+void plate_field_fast(const PlateFrame& p, float px, float py, float& fx, float& fy)
+{
+  plate_field_impl<true>(p, px, py, fx, fy);
+}
+
+/* The charge spread evenly along the plate, lambda = charge/length,
+   integrated over its length:
+
+     lambda * (asinh((length - s)/|h|) + asinh(s/|h|))
+       = lambda * ln((t + r_b)/(r_a - s)),   t = length - s,
+
+   with s and h the position along and across the plate and r_a, r_b the
+   distances to its ends.  Where a sum or difference would cancel out,
+   it is replaced by h^2 over the other one. */
+float plate_potential(const PlateFrame& p, float px, float py)
+{
+  float rx = px - p.ax;
+  float ry = py - p.ay;
+  float s = rx*p.dx + ry*p.dy;
+  float h = rx*p.nx + ry*p.ny;
+  float t = p.length - s;
+
+  float h2 = h*h;
+  float ra = sqrt(s*s + h2);
+  float rb = sqrt(t*t + h2);
+
+  float ratio;
+  if(t < 0)
+    ratio = (ra + s)/(rb - t);       // beyond b
+  else if(s > 0)
+    ratio = (t + rb)*(ra + s)/h2;    // alongside, infinite on the plate
+  else
+    ratio = (t + rb)/(ra - s);       // before a
+
+  return p.charge/p.length*log(ratio);
+}
+
+}
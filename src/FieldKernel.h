@@ -0,0 +1,85 @@
+// -*- C++ -*-
+/*
+ * FieldKernel.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _FIELD_KERNEL_H_
+#define _FIELD_KERNEL_H_
+
+#include <vector>
+
+namespace Elfelli
+{
+
+/* Structure-of-arrays copy of the point charges of a scene, laid out
+   so the field kernels can load several bodies at once. */
+struct BodyArrays
+{
+  void clear(){x.clear();y.clear();charge.clear();};
+  void add(float bx, float by, float q){x.push_back(bx);y.push_back(by);charge.push_back(q);};
+  unsigned int size() const{return x.size();};
+
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> charge;
+};
+
+/* Sums charge * (p - body) / |p - body|^3 over all bodies, i.e. the
+   field a unit charge at (px, py) feels.  The implementation is picked
+   once at runtime from the best instruction set the CPU supports. */
+void body_field(const BodyArrays& b, float px, float py, float& fx, float& fy);
+
+/* Sums charge / |p - body| over all bodies, the potential whose
+   negative gradient body_field() is; picked at runtime like
+   body_field(). */
+float body_potential(const BodyArrays& b, float px, float py);
+
+/* Name of the implementation body_field() uses ("avx512", "avx2",
+   "sse2" or "scalar"). */
+const char *body_field_isa();
+
+/* A charged plate in its own frame: start point, unit vectors along and
+   across the plate, length, and the charge scaled by 30/length as the
+   plate field is defined. */
+struct PlateFrame
+{
+  void set(float ax, float ay, float bx, float by, float q);
+
+  float ax, ay;
+  float dx, dy;
+  float nx, ny;
+  float length;
+  float charge;
+};
+
+/* Add the field of the plate at (px, py) to (fx, fy).  Points in line
+   with the plate are handled by the limit of the formula; nothing is
+   added on the plate itself.  plate_field() uses the libm functions,
+   plate_field_fast() polynomial atan2 and log with an absolute error
+   below 1e-7. */
+void plate_field(const PlateFrame& p, float px, float py, float& fx, float& fy);
+void plate_field_fast(const PlateFrame& p, float px, float py, float& fx, float& fy);
+
+/* Potential of the plate at (px, py), taking its charge as spread
+   evenly along it; the logarithm of a finite line charge.  Infinite on
+   the plate itself. */
+float plate_potential(const PlateFrame& p, float px, float py);
+
+}
+
+#endif // _FIELD_KERNEL_H_
@@ -0,0 +1,223 @@
+/*
+ * FieldMap.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "FieldMap.h"
+#include "Parallel.h"
+#include "Simulation.h"
+
+#include <math.h>
+#include <algorithm>
+
+namespace Elfelli
+{
+
+const unsigned int FieldMap::CELL(4);
+const unsigned int FieldMap::TILE(16);
+
+FieldMap::FieldMap():
+  type(HEATMAP_NONE), width(0), height(0), nx(0), ny(0), tiles_x(0), tiles_y(0),
+  lo(0), hi(1)
+{
+}
+
+void FieldMap::clear()
+{
+  samples.clear();
+  changed.clear();
+  width = height = nx = ny = tiles_x = tiles_y = 0;
+}
+
+/* Tile (tx, ty) holds the nodes [tx*TILE, (tx+1)*TILE) x [ty*TILE,
+   (ty+1)*TILE) and paints the pixels of the cells starting there. */
+void FieldMap::sample_tile(unsigned int t, const ValueFunc& value)
+{
+  /* Nodes right on a charge get a huge value instead of an infinite
+     one, so interpolating towards them stays finite. */
+  const float HUGE_VALUE = 1e30;
+
+  unsigned int i0 = (t % tiles_x)*TILE, j0 = (t / tiles_x)*TILE;
+  unsigned int i1 = std::min(i0 + TILE, nx), j1 = std::min(j0 + TILE, ny);
+  for(unsigned int j=j0; j<j1; ++j)
+    for(unsigned int i=i0; i<i1; ++i)
+      {
+        float v = value(static_cast<float>(i*CELL), static_cast<float>(j*CELL));
+        if(!isfinite(v))
+          v = (v > 0) ? HUGE_VALUE : -HUGE_VALUE;
+        samples[j*nx + i] = v;
+      }
+}
+
+/* A tile is painted from its own nodes and the first ones of the tiles
+   to the right and below, so those have to be painted again too. */
+void FieldMap::mark(unsigned int tx, unsigned int ty)
+{
+  for(unsigned int y=(ty > 0 ? ty - 1 : 0); y<=ty; ++y)
+    for(unsigned int x=(tx > 0 ? tx - 1 : 0); x<=tx; ++x)
+      changed[y*tiles_x + x] = 1;
+}
+
+void FieldMap::build(HeatmapType type, unsigned int width, unsigned int height,
+                     unsigned int threads, const ValueFunc& value)
+{
+  clear();
+  this->type = type;
+  if(type == HEATMAP_NONE || width == 0 || height == 0)
+    return;
+
+  this->width = width;
+  this->height = height;
+  nx = (width + CELL - 1)/CELL + 1;
+  ny = (height + CELL - 1)/CELL + 1;
+  tiles_x = (nx + TILE - 1)/TILE;
+  tiles_y = (ny + TILE - 1)/TILE;
+  samples.resize(nx*ny);
+  changed.assign(tiles_x*tiles_y, 1);
+
+  parallel_for(tiles_x*tiles_y, threads,
+               [&](unsigned int t){sample_tile(t, value);});
+
+  /* The ends of the scale leave out the few extreme values right next
+     to the charges.  The potential is shown symmetric around zero. */
+  std::vector<float> sorted;
+  sorted.reserve(samples.size());
+  for(unsigned int k=0; k<samples.size(); ++k)
+    if(fabs(samples[k]) < 1e29)
+      sorted.push_back(type == HEATMAP_POTENTIAL ? fabs(samples[k]) : samples[k]);
+  if(sorted.empty())
+    return;
+
+  auto percentile = [&](float p)
+    {
+      std::vector<float>::iterator it = sorted.begin() + static_cast<unsigned int>(p*(sorted.size() - 1));
+      std::nth_element(sorted.begin(), it, sorted.end());
+      return *it;
+    };
+
+  if(type == HEATMAP_POTENTIAL)
+    {
+      hi = percentile(0.95);
+      lo = -hi;
+    }
+  else
+    {
+      lo = percentile(0.02);
+      hi = percentile(0.99);
+    }
+  if(!(hi > lo))
+    hi = lo + 1;
+}
+
+void FieldMap::update(const std::vector<Vec2>& near, float radius,
+                      unsigned int threads, const ValueFunc& value)
+{
+  if(samples.empty() || near.empty())
+    return;
+
+  const float size = TILE*CELL;
+
+  std::vector<unsigned int> tiles;
+  for(unsigned int ty=0; ty<tiles_y; ++ty)
+    for(unsigned int tx=0; tx<tiles_x; ++tx)
+      {
+        float x0 = tx*size, y0 = ty*size;
+        for(unsigned int k=0; k<near.size(); ++k)
+          {
+            /* Distance from the point to the tile */
+            float dx = fmax(0, fmax(x0 - near[k].get_x(), near[k].get_x() - (x0 + size)));
+            float dy = fmax(0, fmax(y0 - near[k].get_y(), near[k].get_y() - (y0 + size)));
+            if(dx*dx + dy*dy < radius*radius)
+              {
+                tiles.push_back(ty*tiles_x + tx);
+                mark(tx, ty);
+                break;
+              }
+          }
+      }
+
+  parallel_for(tiles.size(), threads,
+               [&](unsigned int k){sample_tile(tiles[k], value);});
+}
+
+static void palette(HeatmapType type, float t, unsigned char *rgb)
+{
+  /* Light colours, so the lines stay readable: white to orange for the
+     field strength, blue through white to red like the charges for the
+     potential. */
+  static const float field[][3] = {{255, 255, 255}, {255, 240, 190}, {255, 200, 130}, {240, 150, 90}};
+  static const float potential[][3] = {{130, 160, 255}, {255, 255, 255}, {255, 140, 130}};
+
+  const float (*stops)[3] = (type == HEATMAP_POTENTIAL) ? potential : field;
+  int n = (type == HEATMAP_POTENTIAL) ? 3 : 4;
+
+  float s = t*(n - 1);
+  int k = std::min(static_cast<int>(s), n - 2);
+  float f = s - k;
+  for(int c=0; c<3; ++c)
+    rgb[c] = static_cast<unsigned char>(stops[k][c] + f*(stops[k + 1][c] - stops[k][c]) + 0.5f);
+}
+
+void FieldMap::paint_tile(unsigned int t, unsigned char *rgb, unsigned int stride) const
+{
+  const int LEVELS = 256;
+  unsigned char colours[LEVELS][3];
+  for(int k=0; k<LEVELS; ++k)
+    palette(type, static_cast<float>(k)/(LEVELS - 1), colours[k]);
+
+  const float scale = (LEVELS - 1)/(hi - lo);
+  const unsigned int size = TILE*CELL;
+  unsigned int x0 = (t % tiles_x)*size, y0 = (t / tiles_x)*size;
+  unsigned int x1 = std::min(x0 + size, width), y1 = std::min(y0 + size, height);
+
+  for(unsigned int y=y0; y<y1; ++y)
+    {
+      unsigned int j = y/CELL;
+      float fy = static_cast<float>(y % CELL)/CELL;
+      const float *top = &samples[j*nx], *bottom = &samples[(j + 1)*nx];
+
+      unsigned char *out = rgb + y*stride + x0*3;
+      for(unsigned int x=x0; x<x1; ++x)
+        {
+          unsigned int i = x/CELL;
+          float fx = static_cast<float>(x % CELL)/CELL;
+          float a = top[i] + fx*(top[i + 1] - top[i]);
+          float b = bottom[i] + fx*(bottom[i + 1] - bottom[i]);
+          float v = (a + fy*(b - a) - lo)*scale;
+
+          int k = (v > 0) ? static_cast<int>(fmin(v, LEVELS - 1)) : 0;
+          *out++ = colours[k][0];
+          *out++ = colours[k][1];
+          *out++ = colours[k][2];
+        }
+    }
+}
+
+void FieldMap::paint(unsigned char *rgb, unsigned int stride, unsigned int threads, bool all)
+{
+  std::vector<unsigned int> tiles;
+  for(unsigned int t=0; t<changed.size(); ++t)
+    if(changed[t] || all)
+      tiles.push_back(t);
+
+  parallel_for(tiles.size(), threads,
+               [&](unsigned int k){paint_tile(tiles[k], rgb, stride);});
+
+  std::fill(changed.begin(), changed.end(), 0);
+}
+
+}
@@ -0,0 +1,88 @@
+// -*- C++ -*-
+/*
+ * FieldMap.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _FIELD_MAP_H_
+#define _FIELD_MAP_H_
+
+#include <vector>
+#include <functional>
+
+namespace Elfelli
+{
+
+class Vec2;
+
+enum HeatmapType
+  {
+    HEATMAP_NONE = 0,
+    HEATMAP_FIELD,       // log of the field strength
+    HEATMAP_POTENTIAL
+  };
+
+/* A colour map of the field strength or the potential behind the
+   lines.  Values are sampled every CELL pixels and drawn with bilinear
+   interpolation; the samples are kept in square tiles that are sampled
+   and painted on their own, so moving a single body only costs the
+   tiles around it. */
+class FieldMap
+{
+public:
+  FieldMap();
+
+  typedef std::function<float(float, float)> ValueFunc;
+
+  /* Samples all tiles of a width x height image and fixes the colour
+     scale from the values found. */
+  void build(HeatmapType type, unsigned int width, unsigned int height,
+             unsigned int threads, const ValueFunc& value);
+
+  /* Samples the tiles within `radius' of any of the points again,
+     keeping the colour scale. */
+  void update(const std::vector<Vec2>& near, float radius,
+              unsigned int threads, const ValueFunc& value);
+
+  void clear();
+  bool empty() const{return samples.empty();};
+  HeatmapType get_type() const{return type;};
+
+  /* Paints the tiles changed since the last call into a width x height
+     RGB image with `stride' bytes per row; everything if `all'. */
+  void paint(unsigned char *rgb, unsigned int stride, unsigned int threads, bool all=false);
+
+  static const unsigned int CELL;
+  static const unsigned int TILE;   // cells per tile edge
+
+private:
+  void sample_tile(unsigned int t, const ValueFunc& value);
+  void paint_tile(unsigned int t, unsigned char *rgb, unsigned int stride) const;
+  void mark(unsigned int tx, unsigned int ty);
+
+  HeatmapType type;
+  unsigned int width, height;
+  unsigned int nx, ny;            // nodes
+  unsigned int tiles_x, tiles_y;
+  std::vector<float> samples;
+  std::vector<unsigned char> changed;
+  float lo, hi;                   // values shown with the ends of the scale
+};
+
+}
+
+#endif // _FIELD_MAP_H_
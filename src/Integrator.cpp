@@ -0,0 +1,155 @@
+/*
+ * Integrator.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "Integrator.h"
+#include "Simulation.h"
+
+#include <math.h>
+
+namespace Elfelli
+{
+
+const float EulerIntegrator::STEP(5);
+
+const float RK45Integrator::MIN_STEP(0.25);
+const float RK45Integrator::MAX_STEP(200);
+const float RK45Integrator::MAX_TURN(0.707);  // cos 45 degrees
+
+const Integrator& Integrator::get(IntegratorType type)
+{
+  static const EulerIntegrator euler;
+  static const RK45Integrator rk45;
+
+  switch(type)
+  {
+  case INTEGRATOR_RK45:
+    return rk45;
+  case INTEGRATOR_EULER:
+  default:
+    return euler;
+  }
+}
+
+/* Unit vector along the force; zero where the field vanishes, so the
+   step simply does not move instead of producing NaNs.  The strength of
+   the force is stored in `strength' if given. */
+static inline Vec2 direction(const Simulation& sim, const Vec2& pos, float charge,
+                             float *strength=0)
+{
+  Vec2 f = sim.trace_force(pos, charge);
+  float l = f.length();
+  if(strength)
+    *strength = isfinite(l) ? l : 0;
+  if(!(l > 0) || !isfinite(l))
+    return Vec2(0, 0);
+  return f/l;
+}
+
+void EulerIntegrator::advance(const Simulation& sim, const TraceOptions&, Particle& p) const
+{
+  p.dir = direction(sim, p.pos, p.charge, &p.field);
+  p.pos += p.dir * STEP;
+  p.s += STEP;
+}
+
+void RK45Integrator::advance(const Simulation& sim, const TraceOptions& opts, Particle& p) const
+{
+  /* Dormand-Prince coefficients */
+  static const float a21 = 1.0/5;
+  static const float a31 = 3.0/40, a32 = 9.0/40;
+  static const float a41 = 44.0/45, a42 = -56.0/15, a43 = 32.0/9;
+  static const float a51 = 19372.0/6561, a52 = -25360.0/2187, a53 = 64448.0/6561, a54 = -212.0/729;
+  static const float a61 = 9017.0/3168, a62 = -355.0/33, a63 = 46732.0/5247, a64 = 49.0/176, a65 = -5103.0/18656;
+  static const float b1 = 35.0/384, b3 = 500.0/1113, b4 = 125.0/192, b5 = -2187.0/6784, b6 = 11.0/84;
+  static const float e1 = 71.0/57600, e3 = -71.0/16695, e4 = 71.0/1920, e5 = -17253.0/339200,
+    e6 = 22.0/525, e7 = -1.0/40;
+
+  /* Dense output (Hairer, Norsett & Wanner): the step as a quartic in
+     the fraction t of it, by the coefficients of t, t^2, t^3 and t^4
+     for each stage; the second stage does not contribute. */
+  static const float d1[4] = {1, -8048581381.0/2820520608, 8663915743.0/2820520608,
+                              -12715105075.0/11282082432};
+  static const float d3[4] = {0, 131558114200.0/32700410799, -68118460800.0/10900136933,
+                              87487479700.0/32700410799};
+  static const float d4[4] = {0, -1754552775.0/470086768, 14199869525.0/1410260304,
+                              -10690763975.0/1880347072};
+  static const float d5[4] = {0, 127303824393.0/49829197408, -318862633887.0/49829197408,
+                              701980252875.0/199316789632};
+  static const float d6[4] = {0, -282668133.0/205662961, 2019193451.0/616988883,
+                              -1453857185.0/822651844};
+  static const float d7[4] = {0, 40617522.0/29380423, -110615467.0/29380423,
+                              69997945.0/29380423};
+
+  const float tol = opts.tolerance;
+
+  /* The direction at the end of a step is the first stage of the next
+     one, so it is kept in the particle. */
+  float h = p.h;
+  Vec2 k1 = p.dir;
+  if(h <= 0)
+  {
+    h = EulerIntegrator::STEP;
+    k1 = direction(sim, p.pos, p.charge);
+  }
+
+  const Vec2 x = p.pos;
+  for(;;)
+  {
+    Vec2 k2 = direction(sim, x + k1*(h*a21), p.charge);
+    Vec2 k3 = direction(sim, x + (k1*a31 + k2*a32)*h, p.charge);
+    Vec2 k4 = direction(sim, x + (k1*a41 + k2*a42 + k3*a43)*h, p.charge);
+    Vec2 k5 = direction(sim, x + (k1*a51 + k2*a52 + k3*a53 + k4*a54)*h, p.charge);
+    Vec2 k6 = direction(sim, x + (k1*a61 + k2*a62 + k3*a63 + k4*a64 + k5*a65)*h, p.charge);
+    Vec2 next = x + (k1*b1 + k3*b3 + k4*b4 + k5*b5 + k6*b6)*h;
+    float strength;
+    Vec2 k7 = direction(sim, next, p.charge, &strength);
+
+    /* Embedded error estimate per unit of arc length, so the total
+       deviation of a line grows with its length only. */
+    float e = (k1*e1 + k3*e3 + k4*e4 + k5*e5 + k6*e6 + k7*e7).length();
+
+    float scale = 5;
+    if(e > 0)
+      scale = fmax(0.2f, fmin(5.0f, 0.9f*pow(tol/e, 0.25f)));
+
+    /* The error estimate cannot be trusted once a step goes around a
+       sharp bend, so such steps are shortened as well.  Steps past a
+       body that turn by 50 degrees were seen to be ten times as far
+       off as it claimed. */
+    float turn = k1.get_x()*k7.get_x() + k1.get_y()*k7.get_y();
+    if(turn < MAX_TURN)
+      scale = fmin(scale, 0.5f);
+
+    if((e <= tol && turn >= MAX_TURN) || h <= MIN_STEP)
+    {
+      p.pos = next;
+      p.s += h;
+      p.dir = k7;
+      p.field = strength;
+      p.h = fmax(MIN_STEP, fmin(MAX_STEP, h*scale));
+      for(int i=0; i<4; ++i)
+        p.dense[i] = (k1*d1[i] + k3*d3[i] + k4*d4[i] + k5*d5[i] + k6*d6[i] + k7*d7[i])*h;
+      return;
+    }
+
+    h = fmax(MIN_STEP, h*scale);
+  }
+}
+
+}
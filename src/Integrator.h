@@ -0,0 +1,82 @@
+// -*- C++ -*-
+/*
+ * Integrator.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _INTEGRATOR_H_
+#define _INTEGRATOR_H_
+
+namespace Elfelli
+{
+
+class Simulation;
+struct Particle;
+struct TraceOptions;
+
+enum IntegratorType
+  {
+    INTEGRATOR_EULER = 0,
+    INTEGRATOR_RK45
+  };
+
+/* Moves a particle one step along the direction of the field, i.e.
+   integrates dx/ds = F(x)/|F(x)| over the arc length s.  Integrators
+   keep no state of their own; anything that has to survive between
+   steps is stored in the Particle. */
+class Integrator
+{
+public:
+  virtual ~Integrator(){};
+
+  virtual void advance(const Simulation& sim, const TraceOptions& opts, Particle& p) const = 0;
+
+  /* True if a step may be longer than a body, so absorption has to be
+     tested along the whole step instead of at its end only. */
+  virtual bool long_steps() const = 0;
+
+  static const Integrator& get(IntegratorType type);
+};
+
+/* The original fixed-step method: 5 units along the normalized force. */
+class EulerIntegrator : public Integrator
+{
+public:
+  virtual void advance(const Simulation& sim, const TraceOptions& opts, Particle& p) const;
+  virtual bool long_steps() const{return false;};
+
+  static const float STEP;
+};
+
+/* Dormand-Prince 5(4) with step size control on the arc length.  A
+   step is accepted when the embedded error estimate per unit length
+   stays below the tolerance; the end direction is reused as the first
+   stage of the next step. */
+class RK45Integrator : public Integrator
+{
+public:
+  virtual void advance(const Simulation& sim, const TraceOptions& opts, Particle& p) const;
+  virtual bool long_steps() const{return true;};
+
+  static const float MIN_STEP;
+  static const float MAX_STEP;
+  static const float MAX_TURN;
+};
+
+}
+
+#endif // _INTEGRATOR_H_
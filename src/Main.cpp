@@ -18,9 +18,23 @@
  */
 
 #include "Application.h"
+#include "BatchRenderer.h"
+
+#include <glibmm/thread.h>
 
 int main(int argc, char *argv[])
 {
+  /* Rendering scene files needs no display. */
+  if(Elfelli::BatchRenderer::wanted(argc, argv))
+    return Elfelli::BatchRenderer::main(argc, argv);
+
+  /* The flux lines are traced on a worker thread that talks to the
+     main loop through a Glib::Dispatcher. */
+#if GLIBMM_MAJOR_VERSION == 2 && GLIBMM_MINOR_VERSION < 32
+  if(!Glib::thread_supported())
+    Glib::thread_init();
+#endif
+
   Elfelli::Application app(argc, argv);
 
   return app.main();
@@ -0,0 +1,108 @@
+/*
+ * OccupancyGrid.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "OccupancyGrid.h"
+
+#include <math.h>
+
+namespace Elfelli
+{
+
+OccupancyGrid::OccupancyGrid():
+  x0(0), y0(0), x1(0), y1(0), cell(1), nx(0), ny(0)
+{
+}
+
+void OccupancyGrid::clear()
+{
+  for(unsigned int c=0; c<cells.size(); ++c)
+    cells[c].clear();
+}
+
+void OccupancyGrid::build(float x0, float y0, float x1, float y1, float cell)
+{
+  this->x0 = x0;
+  this->y0 = y0;
+  this->x1 = x1;
+  this->y1 = y1;
+  this->cell = cell;
+
+  nx = ny = 0;
+  if(x1 > x0 && y1 > y0 && cell > 0)
+    {
+      nx = static_cast<unsigned int>(ceil((x1 - x0)/cell));
+      ny = static_cast<unsigned int>(ceil((y1 - y0)/cell));
+    }
+
+  /* The per-cell vectors keep their memory between runs */
+  clear();
+  cells.resize(nx*ny);
+}
+
+bool OccupancyGrid::inside(float x, float y) const
+{
+  return x >= x0 && x < x1 && y >= y0 && y < y1;
+}
+
+void OccupancyGrid::add(float x, float y)
+{
+  if(!inside(x, y))
+    return;
+
+  unsigned int i = static_cast<unsigned int>((x - x0)/cell);
+  unsigned int j = static_cast<unsigned int>((y - y0)/cell);
+  if(i >= nx || j >= ny)
+    return;
+
+  Point p = {x, y};
+  cells[j*nx + i].push_back(p);
+}
+
+bool OccupancyGrid::occupied(float x, float y, float dist) const
+{
+  if(nx == 0)
+    return false;
+
+  /* dist <= cell, so the 3x3 cells around the point are enough */
+  int ci = static_cast<int>(floor((x - x0)/cell));
+  int cj = static_cast<int>(floor((y - y0)/cell));
+  float d2 = dist*dist;
+
+  for(int j=cj-1; j<=cj+1; ++j)
+    {
+      if(j < 0 || j >= static_cast<int>(ny))
+        continue;
+      for(int i=ci-1; i<=ci+1; ++i)
+        {
+          if(i < 0 || i >= static_cast<int>(nx))
+            continue;
+          const std::vector<Point>& c = cells[j*nx + i];
+          for(unsigned int k=0; k<c.size(); ++k)
+            {
+              float dx = c[k].x - x, dy = c[k].y - y;
+              if(dx*dx + dy*dy < d2)
+                return true;
+            }
+        }
+    }
+
+  return false;
+}
+
+}
@@ -0,0 +1,62 @@
+// -*- C++ -*-
+/*
+ * OccupancyGrid.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _OCCUPANCY_GRID_H_
+#define _OCCUPANCY_GRID_H_
+
+#include <vector>
+
+namespace Elfelli
+{
+
+/* Points of the lines traced so far, bucketed into square cells, to
+   tell whether a new line comes too close to them.  Used to space
+   lines evenly. */
+class OccupancyGrid
+{
+public:
+  OccupancyGrid();
+
+  /* Covers the rectangle with cells of the given size and forgets all
+     points.  Distances up to `cell' can be tested. */
+  void build(float x0, float y0, float x1, float y1, float cell);
+  void clear();
+
+  bool inside(float x, float y) const;
+
+  void add(float x, float y);
+
+  /* Whether any point is closer than `dist' to (x, y). */
+  bool occupied(float x, float y, float dist) const;
+
+private:
+  struct Point
+  {
+    float x, y;
+  };
+
+  float x0, y0, x1, y1, cell;
+  unsigned int nx, ny;
+  std::vector<std::vector<Point> > cells;
+};
+
+}
+
+#endif // _OCCUPANCY_GRID_H_
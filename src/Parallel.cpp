@@ -0,0 +1,106 @@
+/*
+ * Parallel.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "Parallel.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <cstdlib>
+
+namespace Elfelli
+{
+
+unsigned int hardware_threads()
+{
+  const char *env = std::getenv("ELFELLI_THREADS");
+  if(env)
+  {
+    int n = std::atoi(env);
+    if(n > 0)
+      return n;
+  }
+
+  unsigned int n = std::thread::hardware_concurrency();
+  if(n == 0)
+    n = 1;
+  return n;
+}
+
+bool parse_threads(const char *s, unsigned int& threads)
+{
+  char *end;
+  errno = 0;
+  long n = std::strtol(s, &end, 10);
+  if(end == s || *end != '\0' || errno != 0 || n < 0 || n > static_cast<long>(MAX_THREADS))
+    return false;
+
+  threads = n;
+  return true;
+}
+
+unsigned int parallel_threads(unsigned int n, unsigned int threads)
+{
+  if(threads == 0)
+    threads = hardware_threads();
+  if(threads > n)
+    threads = n;
+  if(threads == 0)
+    threads = 1;
+  return threads;
+}
+
+void parallel_for(unsigned int n, unsigned int threads,
+                  const std::function<void(unsigned int)>& func)
+{
+  parallel_for_thread(n, threads, [&](unsigned int i, unsigned int){func(i);});
+}
+
+void parallel_for_thread(unsigned int n, unsigned int threads,
+                         const std::function<void(unsigned int, unsigned int)>& func)
+{
+  threads = parallel_threads(n, threads);
+
+  if(threads <= 1)
+  {
+    for(unsigned int i=0; i<n; ++i)
+      func(i, 0);
+    return;
+  }
+
+  std::atomic<unsigned int> next(0);
+  auto worker = [&](unsigned int t)
+    {
+      unsigned int i;
+      while((i = next.fetch_add(1)) < n)
+        func(i, t);
+    };
+
+  std::vector<std::thread> pool;
+  for(unsigned int t=1; t<threads; ++t)
+    pool.push_back(std::thread(worker, t));
+
+  worker(0);
+
+  for(unsigned int t=0; t<pool.size(); ++t)
+    pool[t].join();
+}
+
+}
@@ -0,0 +1,58 @@
+// -*- C++ -*-
+/*
+ * Parallel.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <functional>
+
+namespace Elfelli
+{
+
+/* Number of worker threads to use when none is configured explicitly.
+   Honours the ELFELLI_THREADS environment variable, otherwise one
+   thread per available core. */
+unsigned int hardware_threads();
+
+/* Reads a thread count from the command line into `threads': a whole
+   number from 0 (hardware_threads()) to MAX_THREADS.  Returns false and
+   leaves `threads' alone for anything else. */
+const unsigned int MAX_THREADS = 1024;
+bool parse_threads(const char *s, unsigned int& threads);
+
+/* Calls func(i) for every i in [0, n) using up to `threads' threads
+   (0 means hardware_threads()).  Items are handed out one at a time, so
+   long and short items balance out between the threads.  With a single
+   thread everything runs on the calling thread. */
+void parallel_for(unsigned int n, unsigned int threads,
+                  const std::function<void(unsigned int)>& func);
+
+/* Number of threads parallel_for() really starts for n items. */
+unsigned int parallel_threads(unsigned int n, unsigned int threads);
+
+/* Like parallel_for(), but calls func(i, t) where t in
+   [0, parallel_threads(n, threads)) identifies the calling thread, so
+   per-thread buffers can be used without locking. */
+void parallel_for_thread(unsigned int n, unsigned int threads,
+                         const std::function<void(unsigned int, unsigned int)>& func);
+
+}
+
+#endif // _PARALLEL_H_
@@ -0,0 +1,81 @@
+/*
+ * Polyline.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "Polyline.h"
+#include "Simulation.h"
+
+namespace Elfelli
+{
+
+unsigned int simplify_polyline(Vec2 *points, unsigned int n, float tolerance,
+                               std::vector<unsigned int>& stack)
+{
+  if(n <= 2)
+    return n;
+
+  const float tol2 = tolerance*tolerance;
+
+  /* The pieces [a, stack.back()] are split depth first, left to right,
+     so the kept points come out in order and can be written over the
+     ones already passed. */
+  unsigned int a = 0, w = 0;
+  stack.clear();
+  stack.push_back(n - 1);
+
+  while(!stack.empty())
+    {
+      unsigned int b = stack.back();
+
+      float ax = points[a].get_x(), ay = points[a].get_y();
+      float dx = points[b].get_x() - ax, dy = points[b].get_y() - ay;
+      float l2 = dx*dx + dy*dy;
+
+      float worst = tol2;
+      unsigned int split = 0;
+      for(unsigned int i=a+1; i<b; ++i)
+        {
+          float px = points[i].get_x() - ax, py = points[i].get_y() - ay;
+          float u = 0;
+          if(l2 > 0)
+            u = fmax(0.0f, fmin(1.0f, (px*dx + py*dy)/l2));
+          px -= u*dx;
+          py -= u*dy;
+          float d2 = px*px + py*py;
+          if(d2 > worst)
+            {
+              worst = d2;
+              split = i;
+            }
+        }
+
+      if(split)
+        stack.push_back(split);
+      else
+        {
+          points[w++] = points[a];
+          a = b;
+          stack.pop_back();
+        }
+    }
+
+  points[w++] = points[n - 1];
+  return w;
+}
+
+}
@@ -0,0 +1,41 @@
+// -*- C++ -*-
+/*
+ * Polyline.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _POLYLINE_H_
+#define _POLYLINE_H_
+
+#include <vector>
+
+namespace Elfelli
+{
+
+class Vec2;
+
+/* Douglas-Peucker simplification of the n points in place: drops every
+   point that lies within `tolerance' of the segment replacing it.  The
+   first and last point are always kept.  `stack' is scratch space, so
+   repeated calls allocate nothing.  Returns the number of points
+   left. */
+unsigned int simplify_polyline(Vec2 *points, unsigned int n, float tolerance,
+                               std::vector<unsigned int>& stack);
+
+}
+
+#endif // _POLYLINE_H_
@@ -0,0 +1,260 @@
+/*
+ * PotentialGrid.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "PotentialGrid.h"
+#include "Parallel.h"
+#include "Simulation.h"
+
+#include <math.h>
+#include <algorithm>
+
+namespace Elfelli
+{
+
+const unsigned int PotentialGrid::TILE(32);
+const unsigned int PotentialGrid::MAX_CROSSINGS(2);
+
+PotentialGrid::PotentialGrid():
+  x0(0), y0(0), cell(1), nx(0), ny(0), min_value(0), max_value(0)
+{
+}
+
+void PotentialGrid::clear()
+{
+  values.clear();
+  nx = ny = 0;
+  min_value = max_value = 0;
+}
+
+void PotentialGrid::build(float left, float top, float right, float bottom, float cell,
+                          unsigned int threads, const PotentialFunc& potential)
+{
+  clear();
+  if(!(right > left && bottom > top && cell > 0))
+    return;
+
+  x0 = left;
+  y0 = top;
+  this->cell = cell;
+  nx = static_cast<unsigned int>(ceil((right - left)/cell)) + 1;
+  ny = static_cast<unsigned int>(ceil((bottom - top)/cell)) + 1;
+  values.resize(nx*ny);
+
+  const unsigned int tiles_x = (nx + TILE - 1)/TILE;
+  const unsigned int tiles_y = (ny + TILE - 1)/TILE;
+  parallel_for(tiles_x*tiles_y, threads,
+               [&](unsigned int t)
+               {
+                 unsigned int i0 = (t % tiles_x)*TILE, j0 = (t / tiles_x)*TILE;
+                 unsigned int i1 = std::min(i0 + TILE, nx), j1 = std::min(j0 + TILE, ny);
+                 for(unsigned int j=j0; j<j1; ++j)
+                   for(unsigned int i=i0; i<i1; ++i)
+                     values[j*nx + i] = potential(x0 + i*cell, y0 + j*cell);
+               });
+
+  /* Nodes right on a charge get a huge value instead of an infinite
+     one, so interpolating towards them stays finite. */
+  const float HUGE_POTENTIAL = 1e30;
+  bool first = true;
+  for(unsigned int k=0; k<values.size(); ++k)
+    {
+      float& v = values[k];
+      if(!isfinite(v))
+        {
+          v = (v > 0) ? HUGE_POTENTIAL : -HUGE_POTENTIAL;
+          continue;
+        }
+      if(first || v < min_value)
+        min_value = v;
+      if(first || v > max_value)
+        max_value = v;
+      first = false;
+    }
+}
+
+/* Edges are numbered horizontal ones first, (i, j)-(i+1, j) as
+   j*(nx-1) + i, then the vertical ones, (i, j)-(i, j+1) as
+   (nx-1)*ny + j*nx + i.  Adds the point where `level' crosses it. */
+void PotentialGrid::crossing(unsigned int edge, float level, FluxLines& l) const
+{
+  const unsigned int horizontal = (nx - 1)*ny;
+
+  unsigned int a, b;
+  if(edge < horizontal)
+    {
+      a = (edge / (nx - 1))*nx + edge % (nx - 1);
+      b = a + 1;
+    }
+  else
+    {
+      a = edge - horizontal;
+      b = a + nx;
+    }
+
+  float va = values[a], vb = values[b];
+  float t = (vb != va) ? (level - va)/(vb - va) : 0.5f;
+  float x = x0 + (a % nx)*cell, y = y0 + (a / nx)*cell;
+  if(b == a + 1)
+    x += t*cell;
+  else
+    y += t*cell;
+
+  l.add(Vec2(x, y));
+}
+
+void PotentialGrid::contours(const std::vector<float>& levels, float tolerance, FluxLines& l)
+{
+  if(nx < 2 || ny < 2 || levels.empty())
+    return;
+
+  /* Only levels within the cells that are kept can show up at all */
+  float lo_kept = max_value, hi_kept = min_value;
+
+  steep.assign((nx - 1)*(ny - 1), 0);
+  for(unsigned int j=0; j+1<ny; ++j)
+    for(unsigned int i=0; i+1<nx; ++i)
+      {
+        const float *v = &values[j*nx + i];
+        float lo = std::min(std::min(v[0], v[1]), std::min(v[nx], v[nx + 1]));
+        float hi = std::max(std::max(v[0], v[1]), std::max(v[nx], v[nx + 1]));
+        unsigned int n = std::upper_bound(levels.begin(), levels.end(), hi)
+          - std::lower_bound(levels.begin(), levels.end(), lo);
+        steep[j*(nx - 1) + i] = n > MAX_CROSSINGS;
+        if(n <= MAX_CROSSINGS)
+          {
+            lo_kept = std::min(lo_kept, lo);
+            hi_kept = std::max(hi_kept, hi);
+          }
+      }
+
+  edge_segments.assign(2*((nx - 1)*ny + nx*(ny - 1)), -1);
+
+  for(unsigned int k=0; k<levels.size(); ++k)
+    if(levels[k] >= lo_kept && levels[k] <= hi_kept)
+      contour(levels[k], tolerance, l);
+}
+
+/* Marching squares: every cell is crossed by zero, one or two pieces
+   of line, each between two of its edges.  The pieces are chained into
+   lines through the edges they share with the neighbouring cells,
+   first those that end at the border or next to a left out cell, then
+   the closed loops. */
+void PotentialGrid::contour(float level, float tolerance, FluxLines& l)
+{
+  /* Edges of the pieces for each combination of corners above the
+     level (bit 0 top left, 1 top right, 2 bottom right, 3 bottom left);
+     edge 0 is the top, 1 right, 2 bottom, 3 left.  Cases 5 and 10 are
+     saddles and decided by the centre of the cell. */
+  static const signed char pieces[16][4] =
+    {
+      {-1, -1, -1, -1}, {3, 0, -1, -1}, {0, 1, -1, -1}, {3, 1, -1, -1},
+      {1, 2, -1, -1},   {3, 0, 1, 2},   {0, 2, -1, -1}, {3, 2, -1, -1},
+      {2, 3, -1, -1},   {0, 2, -1, -1}, {0, 1, 2, 3},   {1, 2, -1, -1},
+      {3, 1, -1, -1},   {0, 1, -1, -1}, {3, 0, -1, -1}, {-1, -1, -1, -1}
+    };
+
+  const unsigned int horizontal = (nx - 1)*ny;
+
+  segments.clear();
+  touched.clear();
+
+  for(unsigned int j=0; j+1<ny; ++j)
+    for(unsigned int i=0; i+1<nx; ++i)
+      {
+        if(steep[j*(nx - 1) + i])
+          continue;
+
+        const float *v = &values[j*nx + i];
+        unsigned int code = (v[0] >= level) | (v[1] >= level) << 1
+          | (v[nx + 1] >= level) << 2 | (v[nx] >= level) << 3;
+        if(code == 0 || code == 15)
+          continue;
+
+        const signed char *p = pieces[code];
+        if(code == 5 || code == 10)
+          {
+            /* The table separates the corners above; a centre above
+               joins them instead. */
+            if(0.25f*(v[0] + v[1] + v[nx] + v[nx + 1]) >= level)
+              p = pieces[code ^ 15];
+          }
+
+        const unsigned int edges[4] = {j*(nx - 1) + i, horizontal + j*nx + i + 1,
+                                       (j + 1)*(nx - 1) + i, horizontal + j*nx + i};
+        for(int k=0; k<4 && p[k] >= 0; k+=2)
+          {
+            int s = segments.size()/2;
+            for(int e=0; e<2; ++e)
+              {
+                unsigned int edge = edges[p[k + e]];
+                segments.push_back(edge);
+                if(edge_segments[2*edge] < 0)
+                  {
+                    edge_segments[2*edge] = s;
+                    touched.push_back(edge);
+                  }
+                else
+                  edge_segments[2*edge + 1] = s;
+              }
+          }
+      }
+
+  const unsigned int n = segments.size()/2;
+  used.assign(n, 0);
+
+  /* Follows the pieces from piece s, entering it through `edge' */
+  auto walk = [&](unsigned int s, unsigned int edge)
+    {
+      crossing(edge, level, l);
+      for(;;)
+        {
+          used[s] = 1;
+          edge = (segments[2*s] == edge) ? segments[2*s + 1] : segments[2*s];
+          crossing(edge, level, l);
+
+          int next = edge_segments[2*edge];
+          if(next == static_cast<int>(s))
+            next = edge_segments[2*edge + 1];
+          if(next < 0 || used[next])
+            break;
+          s = next;
+        }
+
+      if(tolerance > 0)
+        l.simplify_line(tolerance);
+      l.end_line();
+    };
+
+  for(unsigned int s=0; s<n; ++s)
+    for(int e=0; e<2 && !used[s]; ++e)
+      {
+        unsigned int edge = segments[2*s + e];
+        if(edge_segments[2*edge + 1] < 0)
+          walk(s, edge);
+      }
+
+  for(unsigned int s=0; s<n; ++s)
+    if(!used[s])
+      walk(s, segments[2*s]);
+
+  for(unsigned int k=0; k<touched.size(); ++k)
+    edge_segments[2*touched[k]] = edge_segments[2*touched[k] + 1] = -1;
+}
+
+}
@@ -0,0 +1,84 @@
+// -*- C++ -*-
+/*
+ * PotentialGrid.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _POTENTIAL_GRID_H_
+#define _POTENTIAL_GRID_H_
+
+#include <vector>
+#include <functional>
+
+namespace Elfelli
+{
+
+class FluxLines;
+
+/* The potential sampled at the nodes of a regular grid over a
+   rectangle, and the equipotential lines found in it by marching
+   squares.  Filling the grid is the expensive part; contours() for any
+   set of levels only walks the stored samples, so changing the levels
+   evaluates nothing. */
+class PotentialGrid
+{
+public:
+  PotentialGrid();
+
+  typedef std::function<float(float, float)> PotentialFunc;
+
+  /* Samples `potential' every `cell' units over the rectangle, in
+     square tiles shared out between `threads' threads (0 for one per
+     core). */
+  void build(float left, float top, float right, float bottom, float cell,
+             unsigned int threads, const PotentialFunc& potential);
+  void clear();
+  bool empty() const{return values.empty();};
+
+  /* Smallest and largest finite sample */
+  float get_min() const{return min_value;};
+  float get_max() const{return max_value;};
+
+  /* Appends the contour lines of the sorted `levels' to `l', simplified
+     with `tolerance' if above 0.  Cells crossed by more than
+     MAX_CROSSINGS levels, i.e. next to a charge where the grid cannot
+     tell the lines apart any more, are left out. */
+  void contours(const std::vector<float>& levels, float tolerance, FluxLines& l);
+
+  static const unsigned int TILE;
+  static const unsigned int MAX_CROSSINGS;
+
+private:
+  void contour(float level, float tolerance, FluxLines& l);
+  void crossing(unsigned int edge, float level, FluxLines& l) const;
+
+  float x0, y0, cell;
+  unsigned int nx, ny;
+  std::vector<float> values;
+  float min_value, max_value;
+
+  /* Scratch space of contours() */
+  std::vector<unsigned char> steep;      // cell is left out
+  std::vector<unsigned int> segments;    // pairs of edges
+  std::vector<int> edge_segments;        // two per edge, -1 for none
+  std::vector<unsigned int> touched;     // edges to reset
+  std::vector<unsigned char> used;
+};
+
+}
+
+#endif // _POTENTIAL_GRID_H_
@@ -39,6 +39,8 @@ inline void profile_func_start(const char *fname)
   std::cerr << std::setw(funclevel) << "" << "+" << fname << " started." << " [" << funclevel << "]" << std::endl;
 
   gettimeofday(&start_times[funclevel], NULL);
+#else
+  (void)fname;
 #endif // PROFILING
 }
 
@@ -57,6 +59,8 @@ inline void profile_func_end(const char *fname)
   if(funclevel == 0)
     std::cerr << std::endl;
 
+#else
+  (void)fname;
 #endif // PROFILING
 }
 
@@ -0,0 +1,208 @@
+/*
+ * QuadTree.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "QuadTree.h"
+
+#include <math.h>
+
+namespace Elfelli
+{
+
+const unsigned int QuadTree::LEAF_SIZE(8);
+const unsigned int QuadTree::MAX_DEPTH(24);
+
+QuadTree::QuadTree()
+{
+}
+
+void QuadTree::clear()
+{
+  nodes.clear();
+  sorted.clear();
+  order.clear();
+}
+
+void QuadTree::build(const BodyArrays& bodies)
+{
+  clear();
+
+  unsigned int n = bodies.size();
+  if(n == 0)
+    return;
+
+  float x0 = bodies.x[0], y0 = bodies.y[0];
+  float x1 = x0, y1 = y0;
+  for(unsigned int i=0; i<n; ++i)
+  {
+    order.push_back(i);
+    x0 = fmin(x0, bodies.x[i]);
+    y0 = fmin(y0, bodies.y[i]);
+    x1 = fmax(x1, bodies.x[i]);
+    y1 = fmax(y1, bodies.y[i]);
+  }
+  float size = fmax(fmax(x1 - x0, y1 - y0), 1.0f);
+
+  scratch.resize(n);
+  nodes.push_back(Node());
+  build_node(bodies, 0, 0, n, x0, y0, size, 0);
+
+  /* Store the bodies in tree order, so every leaf covers a contiguous
+     range of `sorted'. */
+  for(unsigned int i=0; i<n; ++i)
+    sorted.add(bodies.x[order[i]], bodies.y[order[i]], bodies.charge[order[i]]);
+}
+
+void QuadTree::build_node(const BodyArrays& bodies, int slot,
+                          unsigned int first, unsigned int count,
+                          float x0, float y0, float size, unsigned int depth)
+{
+  float q = 0, weight = 0, cx = 0, cy = 0;
+  for(unsigned int i=first; i<first+count; ++i)
+  {
+    unsigned int k = order[i];
+    float w = fabs(bodies.charge[k]);
+    q += bodies.charge[k];
+    weight += w;
+    cx += w*bodies.x[k];
+    cy += w*bodies.y[k];
+  }
+  if(weight > 0)
+  {
+    cx /= weight;
+    cy /= weight;
+  }
+  else
+  {
+    cx = x0 + size/2;
+    cy = y0 + size/2;
+  }
+
+  float px = 0, py = 0;
+  for(unsigned int i=first; i<first+count; ++i)
+  {
+    unsigned int k = order[i];
+    px += bodies.charge[k]*(bodies.x[k] - cx);
+    py += bodies.charge[k]*(bodies.y[k] - cy);
+  }
+
+  Node& node = nodes[slot];
+  node.cx = cx;
+  node.cy = cy;
+  node.size = size;
+  node.charge = q;
+  node.px = px;
+  node.py = py;
+  node.child = -1;
+  node.first = first;
+  node.count = count;
+
+  if(count <= LEAF_SIZE || depth >= MAX_DEPTH)
+    return;
+
+  /* Stable partition of the range into the four quadrants. */
+  float half = size/2;
+  float mx = x0 + half, my = y0 + half;
+  unsigned int quadrant_count[4] = {0, 0, 0, 0};
+  for(unsigned int i=first; i<first+count; ++i)
+  {
+    unsigned int k = order[i];
+    quadrant_count[(bodies.x[k] >= mx) + 2*(bodies.y[k] >= my)]++;
+  }
+  unsigned int quadrant_start[4];
+  quadrant_start[0] = first;
+  for(int c=1; c<4; ++c)
+    quadrant_start[c] = quadrant_start[c-1] + quadrant_count[c-1];
+
+  unsigned int fill[4] = {quadrant_start[0], quadrant_start[1], quadrant_start[2], quadrant_start[3]};
+  for(unsigned int i=first; i<first+count; ++i)
+  {
+    unsigned int k = order[i];
+    scratch[fill[(bodies.x[k] >= mx) + 2*(bodies.y[k] >= my)]++] = k;
+  }
+  for(unsigned int i=first; i<first+count; ++i)
+    order[i] = scratch[i];
+
+  /* The four children are stored next to each other. */
+  int child = nodes.size();
+  node.child = child;
+  nodes.resize(child + 4);
+
+  for(int c=0; c<4; ++c)
+  {
+    build_node(bodies, child + c, quadrant_start[c], quadrant_count[c],
+               x0 + (c & 1)*half, y0 + (c >> 1)*half, half, depth+1);
+  }
+}
+
+void QuadTree::field(float px, float py, float theta, float& fx, float& fy) const
+{
+  fx = fy = 0;
+  if(nodes.empty())
+    return;
+
+  const float theta2 = theta*theta;
+
+  int stack[4*MAX_DEPTH + 4];
+  int top = 0;
+  stack[top++] = 0;
+
+  while(top > 0)
+  {
+    const Node& node = nodes[stack[--top]];
+    if(node.count == 0)
+      continue;
+
+    float dx = px - node.cx;
+    float dy = py - node.cy;
+    float r2 = dx*dx + dy*dy;
+
+    if(node.child >= 0 && node.size*node.size < theta2*r2)
+    {
+      /* Monopole plus dipole term:
+         E = q r/|r|^3 + (3 (p.r) r/|r|^2 - p)/|r|^3 */
+      float inv = 1/sqrt(r2);
+      float inv2 = inv*inv;
+      float inv3 = inv2*inv;
+      float pr = 3*(node.px*dx + node.py*dy)*inv2;
+
+      fx += inv3*(node.charge*dx + pr*dx - node.px);
+      fy += inv3*(node.charge*dy + pr*dy - node.py);
+    }
+    else if(node.child >= 0)
+    {
+      for(int c=0; c<4; ++c)
+        stack[top++] = node.child + c;
+    }
+    else
+    {
+      for(unsigned int i=node.first; i<node.first+node.count; ++i)
+      {
+        float bx = px - sorted.x[i];
+        float by = py - sorted.y[i];
+        float inv = 1/sqrt(bx*bx + by*by);
+        float w = sorted.charge[i]*inv*inv*inv;
+
+        fx += w*bx;
+        fy += w*by;
+      }
+    }
+  }
+}
+
+}
@@ -0,0 +1,72 @@
+// -*- C++ -*-
+/*
+ * QuadTree.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _QUADTREE_H_
+#define _QUADTREE_H_
+
+#include <vector>
+
+#include "FieldKernel.h"
+
+namespace Elfelli
+{
+
+/* Barnes-Hut tree over the point charges.  Every cell stores the total
+   charge and the dipole moment of its contents around their centre, so
+   far away cells can be evaluated as a single multipole. */
+class QuadTree
+{
+public:
+  QuadTree();
+
+  void build(const BodyArrays& bodies);
+  void clear();
+  bool empty() const{return nodes.empty();};
+
+  /* Same result as body_field(), approximated: a cell of size s at
+     distance d is expanded when s/d < theta. */
+  void field(float px, float py, float theta, float& fx, float& fy) const;
+
+  static const unsigned int LEAF_SIZE;
+  static const unsigned int MAX_DEPTH;
+
+private:
+  struct Node
+  {
+    float cx, cy;     // expansion centre
+    float size;       // edge length of the cell
+    float charge;     // monopole moment
+    float px, py;     // dipole moment around (cx, cy)
+    int child;        // index of the first of four children, -1 for leaves
+    unsigned int first, count;
+  };
+
+  void build_node(const BodyArrays& bodies, int slot,
+                  unsigned int first, unsigned int count,
+                  float x0, float y0, float size, unsigned int depth);
+
+  std::vector<Node> nodes;
+  BodyArrays sorted;
+  std::vector<unsigned int> order, scratch;
+};
+
+}
+
+#endif // _QUADTREE_H_
@@ -0,0 +1,135 @@
+/*
+ * ResultCache.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "ResultCache.h"
+
+#include <string.h>
+
+namespace Elfelli
+{
+
+SceneKey::SceneKey(const Simulation& sim)
+{
+  const std::vector<Body>& bodies = sim.get_bodies();
+  const std::vector<PlateBody>& plates = sim.get_plates();
+  const TraceOptions& o = sim.get_options();
+
+  /* The number of threads does not change the result. */
+  float opts[] = {static_cast<float>(o.vectorize), static_cast<float>(o.barnes_hut), o.theta,
+                  static_cast<float>(o.field_grid), o.exact_radius,
+                  static_cast<float>(o.integrator), o.tolerance,
+                  o.line_density, static_cast<float>(o.max_steps),
+                  static_cast<float>(o.seeding), static_cast<float>(o.line_budget), o.separation,
+                  static_cast<float>(o.skip_arrived), o.simplify,
+                  o.view_x0, o.view_y0, o.view_x1, o.view_y1, o.view_margin};
+  data.assign(opts, opts + sizeof(opts)/sizeof(opts[0]));
+
+  data.push_back(bodies.size());
+  for(unsigned int i=0; i<bodies.size(); ++i)
+  {
+    data.push_back(bodies[i].pos.get_x());
+    data.push_back(bodies[i].pos.get_y());
+    data.push_back(bodies[i].charge);
+  }
+
+  data.push_back(plates.size());
+  for(unsigned int i=0; i<plates.size(); ++i)
+  {
+    data.push_back(plates[i].pos_a.get_x());
+    data.push_back(plates[i].pos_a.get_y());
+    data.push_back(plates[i].pos_b.get_x());
+    data.push_back(plates[i].pos_b.get_y());
+    data.push_back(plates[i].charge);
+  }
+
+  /* 64 bit FNV-1a over the bit patterns */
+  hash = 14695981039346656037ULL;
+  for(unsigned int i=0; i<data.size(); ++i)
+  {
+    unsigned char bytes[sizeof(float)];
+    memcpy(bytes, &data[i], sizeof(float));
+    for(unsigned int j=0; j<sizeof(float); ++j)
+    {
+      hash ^= bytes[j];
+      hash *= 1099511628211ULL;
+    }
+  }
+}
+
+ResultCache::ResultCache(unsigned int max_scenes, unsigned int max_bytes):
+  max_scenes(max_scenes), max_bytes(max_bytes),
+  n_bytes(0), n_hits(0), n_misses(0)
+{
+}
+
+unsigned int ResultCache::size_of(const Entry& e)
+{
+  return sizeof(Entry) + e.key.data.size()*sizeof(float) + sizeof(FluxLines) + e.lines->bytes();
+}
+
+std::shared_ptr<const FluxLines> ResultCache::find(const SceneKey& key)
+{
+  for(std::list<Entry>::iterator i=entries.begin(); i!=entries.end(); ++i)
+  {
+    if(i->key == key)
+    {
+      entries.splice(entries.begin(), entries, i);
+      n_hits++;
+      return entries.front().lines;
+    }
+  }
+
+  n_misses++;
+  return std::shared_ptr<const FluxLines>();
+}
+
+void ResultCache::insert(const SceneKey& key, const std::shared_ptr<const FluxLines>& lines)
+{
+  for(std::list<Entry>::iterator i=entries.begin(); i!=entries.end(); ++i)
+  {
+    if(i->key == key)
+    {
+      n_bytes -= i->bytes;
+      entries.erase(i);
+      break;
+    }
+  }
+
+  entries.push_front(Entry());
+  Entry& e = entries.front();
+  e.key = key;
+  e.lines = lines;
+  e.bytes = size_of(e);
+  n_bytes += e.bytes;
+
+  /* The newest scene is kept even if it alone is over the limit. */
+  while(entries.size() > 1 && (entries.size() > max_scenes || n_bytes > max_bytes))
+  {
+    n_bytes -= entries.back().bytes;
+    entries.pop_back();
+  }
+}
+
+void ResultCache::clear()
+{
+  entries.clear();
+  n_bytes = 0;
+}
+
+}
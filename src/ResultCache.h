@@ -0,0 +1,85 @@
+// -*- C++ -*-
+/*
+ * ResultCache.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _RESULT_CACHE_H_
+#define _RESULT_CACHE_H_
+
+#include <list>
+#include <vector>
+#include <memory>
+
+#include "Simulation.h"
+
+namespace Elfelli
+{
+
+/* Everything the traced lines depend on: positions and charges of all
+   bodies and plates plus the tracing options, and a hash of it. */
+struct SceneKey
+{
+  SceneKey(){hash=0;};
+  SceneKey(const Simulation& sim);
+
+  bool operator==(const SceneKey& k) const{return hash == k.hash && data == k.data;};
+
+  unsigned long long hash;
+  std::vector<float> data;
+};
+
+/* The flux lines of the most recently used scenes, so going back to a
+   scene that was already traced needs no tracing at all.  The least
+   recently used scenes are dropped once either limit is exceeded.  The
+   lines are shared with the caller, never copied. */
+class ResultCache
+{
+public:
+  ResultCache(unsigned int max_scenes=32, unsigned int max_bytes=32<<20);
+
+  /* The lines traced for `key', or none if it is not cached.  They
+     stay valid after the scene is dropped. */
+  std::shared_ptr<const FluxLines> find(const SceneKey& key);
+  void insert(const SceneKey& key, const std::shared_ptr<const FluxLines>& lines);
+  void clear();
+
+  unsigned int hits() const{return n_hits;};
+  unsigned int misses() const{return n_misses;};
+  unsigned int scenes() const{return entries.size();};
+  unsigned int bytes() const{return n_bytes;};
+
+private:
+  struct Entry
+  {
+    SceneKey key;
+    std::shared_ptr<const FluxLines> lines;
+    unsigned int bytes;
+  };
+
+  static unsigned int size_of(const Entry& e);
+
+  /* Most recently used first */
+  std::list<Entry> entries;
+
+  unsigned int max_scenes, max_bytes;
+  unsigned int n_bytes, n_hits, n_misses;
+};
+
+}
+
+#endif // _RESULT_CACHE_H_
@@ -18,9 +18,13 @@
  */
 
 #include "Simulation.h"
+#include "Parallel.h"
+#include "Polyline.h"
 #include "Profiling.h"
 
 #include <math.h>
+#include <random>
+#include <algorithm>
 #include <iostream>
 
 #ifdef PROFILING
@@ -45,14 +49,7 @@ Vec2::Vec2(float x, float y)
   this->y = y;
 }
 
-Vec2 Vec2::operator=(const Vec2& v)
-{
-  x = v.x;
-  y = v.y;
-  return (*this);
-}
-
-Vec2 Vec2::operator+(const Vec2& v)
+Vec2 Vec2::operator+(const Vec2& v) const
 {
   Vec2 r;
   r.x = x+v.x;
@@ -72,7 +69,7 @@ void Vec2::operator-=(const Vec2& v)
   y -= v.y;
 }
 
-Vec2 Vec2::operator-(const Vec2& v)
+Vec2 Vec2::operator-(const Vec2& v) const
 {
   Vec2 r;
   r.x = x-v.x;
@@ -92,7 +89,7 @@ void Vec2::operator/=(float c)
   y /= c;
 }
 
-Vec2 Vec2::operator*(float c)
+Vec2 Vec2::operator*(float c) const
 {
   Vec2 r;
   r.x = x*c;
@@ -100,7 +97,7 @@ Vec2 Vec2::operator*(float c)
   return r;
 }
 
-Vec2 Vec2::operator/(float c)
+Vec2 Vec2::operator/(float c) const
 {
   Vec2 r;
   r.x = x/c;
@@ -108,7 +105,7 @@ Vec2 Vec2::operator/(float c)
   return r;
 }
 
-Vec2 Vec2::operator-()
+Vec2 Vec2::operator-() const
 {
   return Vec2(-x, -y);
 }
@@ -126,12 +123,32 @@ Vec2 Vec2::normalize() const
 }
 
 
-Vec2 Simulation::force_at(const Vec2& pos, float charge)
+TraceOptions::TraceOptions():
+  threads(0), vectorize(true), barnes_hut(false), theta(0.3),
+  field_grid(false), exact_radius(20),
+  integrator(INTEGRATOR_RK45), tolerance(0.003),
+  line_density(1), max_steps(0),
+  seeding(SEEDING_CHARGE), line_budget(0), separation(12), skip_arrived(true),
+  simplify(0.3),
+  view_x0(0), view_y0(0), view_x1(0), view_y1(0), view_margin(50)
+{
+}
+
+static const float BODY_SIZE = 5;
+
+Simulation::Simulation():
+  edited_body(-1), edited_plate(-1), edit_bodies(0), edit_plates(0),
+  far_charge(0), far_radius(0), stagnant_field(0)
+{
+  std::fill(end_counts, end_counts + END_REASONS_NUM, 0);
+}
+
+Vec2 Simulation::force_at(const Vec2& pos, float charge) const
 {
   Vec2 f(0,0);
   for(unsigned int i=0; i<bodies.size(); ++i)
     {
-      Body& body = bodies[i];
+      const Body& body = bodies[i];
       Vec2 v = body.pos - pos;
       float dist = v.length();
       Vec2 t = (v.normalize())/(dist*dist);
@@ -139,85 +156,381 @@ Vec2 Simulation::force_at(const Vec2& pos, float charge)
       f -= t * (charge * body.charge);
     }
 
+  /* The plate frames are set up here instead of in prepare(), so the
+     reference also works on a scene that was never run. */
+  float fx = 0, fy = 0;
   for(unsigned int i=0; i<plates.size(); ++i)
     {
-      PlateBody& plate = plates[i];
+      const PlateBody& plate = plates[i];
 
-      float xa, ya, xb, yb;
-      Vec2 v;
-      xa = plate.pos_a.get_x() - pos.get_x();
-      ya = plate.pos_a.get_y() - pos.get_y();
-      xb = plate.pos_b.get_x() - plate.pos_a.get_x();
-      yb = plate.pos_b.get_y() - plate.pos_a.get_y();
+      PlateFrame frame;
+      frame.set(plate.pos_a.get_x(), plate.pos_a.get_y(),
+                plate.pos_b.get_x(), plate.pos_b.get_y(), plate.charge);
+      plate_field(frame, pos.get_x(), pos.get_y(), fx, fy);
+    }
 
-      float u = (-(2*ya*yb+2*xa*xb)*atan((yb*yb+ya*yb+xb*xb+xa*xb)/(xa*yb-xb*ya))-(xb*ya-xa*yb)*
-                 log(yb*yb+2*ya*yb+ya*ya+xb*xb+2*xa*xb+xa*xa)-(-2*ya*yb-2*xa*xb)*atan((ya*yb+xa*xb)/(xa*yb-xb*ya))-xa*log(ya*ya+xa*xa)*
-                 yb+xb*ya*log(ya*ya+xa*xa))/((2*yb*yb+2*xb*xb)*atan((yb*yb+ya*yb+xb*xb+xa*xb)/(xa*yb-xb*ya))+(-2*yb*yb-2*xb*xb)*atan((ya*yb+xa*xb)/(xa*yb-xb*ya)));
-      v.set_x(xa+u*xb);
-      v.set_y(ya+u*yb);
+  return f + Vec2(fx, fy)*charge;
+}
 
-      float dist = v.length();
-      float length = sqrt(xb*xb+yb*yb)/30;
-      Vec2 t = (v.normalize())/(dist*dist);
+/* Potential of a unit charge, whose negative gradient is the field of
+   the bodies; the plates are taken as evenly charged lines, which only
+   approximates the field that is traced near them. */
+float Simulation::potential_at(const Vec2& pos) const
+{
+  float u = 0;
+  for(unsigned int i=0; i<bodies.size(); ++i)
+    u += bodies[i].charge/pos.distance(bodies[i].pos);
 
-      f -= t * (charge * plate.charge/length);
+  for(unsigned int i=0; i<plates.size(); ++i)
+    {
+      const PlateBody& plate = plates[i];
+
+      PlateFrame frame;
+      frame.set(plate.pos_a.get_x(), plate.pos_a.get_y(),
+                plate.pos_b.get_x(), plate.pos_b.get_y(), plate.charge);
+      u += plate_potential(frame, pos.get_x(), pos.get_y());
     }
 
-  return f;
+  return u;
 }
 
-bool Simulation::step(Particle& p, float dtime)
+/* Same as force_at(), but uses the structures set up by prepare(). */
+Vec2 Simulation::trace_force(const Vec2& pos, float charge) const
 {
-  const float BODY_SIZE = 5;
-  const float m = 5;
+  float fx, fy;
+  if(others)
+    {
+      if(!others->sample(pos.get_x(), pos.get_y(), fx, fy))
+        return direct_force(pos, charge);
+
+      if(edited_body >= 0)
+        {
+          const Body& b = bodies[edited_body];
+          float dx = pos.get_x() - b.pos.get_x(), dy = pos.get_y() - b.pos.get_y();
+          float r2 = dx*dx + dy*dy;
+          float s = b.charge/(r2*sqrtf(r2));
+          fx += s*dx;
+          fy += s*dy;
+        }
+      else
+        plate_field_fast(plate_frames[edited_plate], pos.get_x(), pos.get_y(), fx, fy);
+
+      return Vec2(fx, fy)*charge;
+    }
+
+  if(options.field_grid && field_cache.sample(pos.get_x(), pos.get_y(), fx, fy))
+    return Vec2(fx, fy)*charge;
+
+  return direct_force(pos, charge);
+}
+
+/* The field evaluated from all sources, without the grid. */
+Vec2 Simulation::direct_force(const Vec2& pos, float charge) const
+{
+  float fx, fy;
+  if(options.barnes_hut)
+    body_tree.field(pos.get_x(), pos.get_y(), options.theta, fx, fy);
+  else if(options.vectorize)
+    body_field(body_arrays, pos.get_x(), pos.get_y(), fx, fy);
+  else
+    return force_at(pos, charge);
+
+  for(unsigned int i=0; i<plate_frames.size(); ++i)
+    plate_field_fast(plate_frames[i], pos.get_x(), pos.get_y(), fx, fy);
+
+  return Vec2(fx, fy)*charge;
+}
+
+/* Whether `pos' is within 3 units of the plate, not counting the
+   round caps at its ends. */
+static bool touches_plate(const PlateBody& pl, const Vec2& pos)
+{
+  float u, dx, dy;
+
+  float length = (pl.pos_b - pl.pos_a).length();
+
+  u = ( (pos.get_x()-pl.pos_a.get_x())*(pl.pos_b.get_x()-pl.pos_a.get_x())
+        + (pos.get_y()-pl.pos_a.get_y())*(pl.pos_b.get_y()-pl.pos_a.get_y()) )
+    / (length*length);
+  if((u >= 0) && (u <= 1))
+  {
+    dx = pl.pos_a.get_x() + u*(pl.pos_b.get_x()-pl.pos_a.get_x()) - pos.get_x();
+    dy = pl.pos_a.get_y() + u*(pl.pos_b.get_y()-pl.pos_a.get_y()) - pos.get_y();
+
+    if((dx*dx + dy*dy) <= 9)
+      return true;
+  }
+
+  return false;
+}
+
+/* Squared distance of p from the segment a-b. */
+static inline float segment_distance2(const Vec2& p, const Vec2& a, const Vec2& b)
+{
+  float dx = b.get_x() - a.get_x(), dy = b.get_y() - a.get_y();
+  float px = p.get_x() - a.get_x(), py = p.get_y() - a.get_y();
+  float l2 = dx*dx + dy*dy;
+  float u = 0;
+  if(l2 > 0)
+    u = fmax(0.0f, fmin(1.0f, (px*dx + py*dy)/l2));
+  px -= u*dx;
+  py -= u*dy;
+  return px*px + py*py;
+}
+
+/* Whether the step from `from' to `to' comes within 3 units of the
+   plate. */
+static bool crosses_plate(const PlateBody& pl, const Vec2& from, const Vec2& to)
+{
+  /* Two segments are closer than 3 units if they cross or if one of
+     the four end points is. */
+  float d = fmin(fmin(segment_distance2(from, pl.pos_a, pl.pos_b),
+                      segment_distance2(to, pl.pos_a, pl.pos_b)),
+                 fmin(segment_distance2(pl.pos_a, from, to),
+                      segment_distance2(pl.pos_b, from, to)));
+  if(d <= 9)
+    return true;
+
+  Vec2 r = to - from, s = pl.pos_b - pl.pos_a, q = pl.pos_a - from;
+  float rxs = r.get_x()*s.get_y() - r.get_y()*s.get_x();
+  if(rxs != 0)
+  {
+    float t = (q.get_x()*s.get_y() - q.get_y()*s.get_x())/rxs;
+    float u = (q.get_x()*r.get_y() - q.get_y()*r.get_x())/rxs;
+    if(t >= 0 && t <= 1 && u >= 0 && u <= 1)
+      return true;
+  }
+
+  return false;
+}
+
+bool Simulation::step(Particle& p, float /* dtime */) const
+{
+  /* Steps in a row that turn around, and times a line may come back
+     the same way through the same cells, before it counts as stuck */
+  const int OSCILLATIONS = 4;
+  const int REVISITS = 3;
+
+  /* Longest step a line may end with in a body or plate */
+  const float FINAL_STEP = 1;
+
+  const Integrator& integrator = Integrator::get(options.integrator);
+
+  Vec2 from = p.pos, dir = p.dir;
+  float travelled = p.s;
+  integrator.advance(*this, options, p);
 
-  Vec2 f = force_at(p.pos, p.charge);
-  p.pos += f.normalize() * m;
+  /* A long step that runs into a body or plate would cut straight
+     across to it; it is taken again at half the length instead, until
+     it falls short of the body or is short itself, so the line follows
+     the field up to the edge. */
+  bool hit = false;
+  if(integrator.long_steps())
+    while((hit = absorbed(from, p.pos, &p.hit)) && p.s - travelled > FINAL_STEP)
+      {
+        p.hit = -1;
+        p.h = (p.s - travelled)/2;
+        p.pos = from;
+        p.dir = dir;
+        p.s = travelled;
+        integrator.advance(*this, options, p);
+      }
 
-  if(p.n > (2000/m))
+  if(travelled > 2000)
     {
-      if(p.pos.length() > 2000)
-        return false;
-      if(p.n > 10000)
-        return false;
+      if(p.pos.length() > 2000 || p.n > 10000 || travelled > 50000)
+        {
+          p.end = END_LIMIT;
+          return false;
+        }
     }
 
-  for(unsigned int i=0; i<bodies.size(); ++i)
+  if(options.max_steps > 0 && static_cast<unsigned int>(p.n) >= options.max_steps)
     {
-      Vec2& pos = bodies[i].pos;
-      if(p.pos.distance(pos) <= BODY_SIZE)
-        return false;
+      p.end = END_LIMIT;
+      return false;
     }
 
-  for(unsigned int i=0; i<plates.size(); ++i)
+  if(outside_view(p.pos))
     {
-      PlateBody& pl = plates[i];
-      float u, dx, dy;
+      if(leave_view(p, from))
+        {
+          p.end = END_VIEW;
+          return false;
+        }
+    }
+  else
+    p.seen = true;
 
-      float length = (pl.pos_b - pl.pos_a).length();
+  if(integrator.long_steps())
+    {
+      if(hit)
+        {
+          p.pos = absorption_point(from, p.pos);
+          p.end = END_BODY;
+          return false;
+        }
+    }
+  else
+    {
+      const float px = p.pos.get_x(), py = p.pos.get_y();
+      if(capture_grid.find(px, py, px, py,
+                           [&](unsigned int i)
+                           {
+                             if(p.pos.distance(bodies[i].pos) > BODY_SIZE)
+                               return false;
+                             p.hit = i;
+                             return true;
+                           },
+                           [&](unsigned int i){return touches_plate(plates[i], p.pos);}))
+        {
+          p.end = END_BODY;
+          return false;
+        }
+    }
 
-      u = ( (p.pos.get_x()-pl.pos_a.get_x())*(pl.pos_b.get_x()-pl.pos_a.get_x())
-            + (p.pos.get_y()-pl.pos_a.get_y())*(pl.pos_b.get_y()-pl.pos_a.get_y()) )
-      / (length*length);
-    if((u >= 0) && (u <= 1))
+  /* No direction at all, or hardly any field left: the line ran into a
+     point where the field vanishes and would only sit there until the
+     step limit. */
+  if((p.dir.get_x() == 0 && p.dir.get_y() == 0) || p.field < stagnant_field*fabs(p.charge))
     {
-      dx = pl.pos_a.get_x() + u*(pl.pos_b.get_x()-pl.pos_a.get_x()) - p.pos.get_x();
-      dy = pl.pos_a.get_y() + u*(pl.pos_b.get_y()-pl.pos_a.get_y()) - p.pos.get_y();
+      p.end = END_STAGNANT;
+      return false;
+    }
 
-      if((dx*dx + dy*dy) <= 9)
-        return false;
+  /* Around such a point the line rather jumps back and forth.  A long
+     step turning around within a unit of length shows it at once,
+     short steps once they keep doing it. */
+  Vec2 moved = p.pos - from;
+  bool reversed = moved.get_x()*p.moved.get_x() + moved.get_y()*p.moved.get_y() < 0;
+  p.reversals = reversed ? p.reversals + 1 : 0;
+  p.moved = moved;
+  if((integrator.long_steps() && p.s - travelled <= 1
+      && dir.get_x()*p.dir.get_x() + dir.get_y()*p.dir.get_y() < 0)
+     || p.reversals >= OSCILLATIONS)
+    {
+      p.end = END_OSCILLATING;
+      return false;
     }
 
+  if(p.visited.visit(p.pos.get_x(), p.pos.get_y(), moved.get_x(), moved.get_y())
+     && ++p.revisits >= REVISITS)
+    {
+      p.end = END_LOOP;
+      return false;
     }
 
   p.n++;
   return true;
 }
 
+bool Simulation::outside_view(const Vec2& pos) const
+{
+  if(!(options.view_x1 > options.view_x0 && options.view_y1 > options.view_y0))
+    return false;
+
+  const float m = options.view_margin;
+  return pos.get_x() < options.view_x0 - m || pos.get_x() > options.view_x1 + m
+    || pos.get_y() < options.view_y0 - m || pos.get_y() > options.view_y1 + m;
+}
+
+/* Decides from the far field of the scene whether a line that just
+   stepped from `from' to outside the view can ever be seen again.  More
+   than FAR_RADII times the size of the scene away, the field is that of
+   a point charge Q plus a dipole p:
+
+   - Where |Q| r > 2 |p| the field points away from the scene (or
+     towards it) in every direction, and more so farther out.  A line
+     moving away goes straight out for good and is cut off.
+   - If the dipole dominates along the whole loop, the line runs along
+     r = C sin^2(theta) around the scene and comes back at the mirror
+     image of its position across the dipole's symmetry axis.  The line
+     is ended and continues from there, so the loop costs nothing.
+
+   Everything else, e.g. lines heading back in, is traced as usual.
+   Returns true if the line ends here. */
+bool Simulation::leave_view(Particle& p, const Vec2& from) const
+{
+  const float FAR_RADII = 4;
+  const float ESCAPE = 2.5;      // a little above 2 for the higher multipoles
+  const float DOMINANCE = 10;
+
+  Vec2 r = p.pos - far_centre;
+  float dist = r.length();
+  if(dist < FAR_RADII*far_radius)
+    return false;
+
+  Vec2 moved = p.pos - from;
+  if(moved.get_x()*r.get_x() + moved.get_y()*r.get_y() <= 0)
+    return false;
+
+  float monopole = fabs(far_charge);
+  float dipole = far_dipole.length();
+
+  if(monopole*dist > ESCAPE*dipole)
+    return true;
+
+  if(p.seen && dipole > 0)
+    {
+      /* Distance of the apex of the loop */
+      Vec2 axis = far_dipole/dipole;
+      float along = r.get_x()*axis.get_x() + r.get_y()*axis.get_y();
+      float across = r.get_x()*axis.get_y() - r.get_y()*axis.get_x();
+      if(across == 0)
+        return false;
+      float apex = dist*dist*dist/(across*across);
+
+      if(DOMINANCE*monopole*apex < dipole)
+        {
+          p.resume = p.pos - axis*(2*along);
+          p.jump = true;
+          return true;
+        }
+    }
+
+  return false;
+}
+
+/* Whether the step from `from' to `to' touches a body or plate.  Unlike
+   the test of the Euler stepper this looks at the whole step, so long
+   steps cannot jump across a body.  The body hit is stored in `body'. */
+bool Simulation::absorbed(const Vec2& from, const Vec2& to, int *body) const
+{
+  return capture_grid.find(from.get_x(), from.get_y(), to.get_x(), to.get_y(),
+                           [&](unsigned int i)
+                           {
+                             if(segment_distance2(bodies[i].pos, from, to) > BODY_SIZE*BODY_SIZE)
+                               return false;
+                             if(body)
+                               *body = i;
+                             return true;
+                           },
+                           [&](unsigned int i){return crosses_plate(plates[i], from, to);});
+}
+
+/* Where a step from `from' to `to' that absorbed() the line first
+   comes close enough to a body or plate.  The step may still reach a
+   little into it, and the line is to end at its edge instead. */
+Vec2 Simulation::absorption_point(const Vec2& from, const Vec2& to) const
+{
+  const int BISECTIONS = 12;
+
+  float lo = 0, hi = 1;
+  for(int i=0; i<BISECTIONS; ++i)
+    {
+      float mid = (lo + hi)/2;
+      if(absorbed(from, from + (to - from)*mid))
+        hi = mid;
+      else
+        lo = mid;
+    }
+  return from + (to - from)*hi;
+}
+
 void Simulation::add_body(const Vec2& v, float charge)
 {
-  /* Numbers greater than 1024 are reserved for PlateBodies. */
-  if(bodies.size() >= 1024) return;
+  /* Numbers from MAX_BODIES on are reserved for PlateBodies. */
+  if(bodies.size() >= static_cast<unsigned int>(MAX_BODIES)) return;
 
   Body b;
   b.charge = charge;
@@ -234,51 +547,293 @@ void Simulation::add_plate(const Vec2& a, const Vec2& b, float charge)
   plates.push_back(p);
 };
 
-void Simulation::run()
+/* Rebuilds the acceleration structures for the current scene; must be
+   called whenever bodies or plates have changed before tracing. */
+void Simulation::prepare()
 {
-  profile_func_start(__PRETTY_FUNCTION__);
+  prepare_sources();
+
+  if(edit && (bodies.size() != edit_bodies || plates.size() != edit_plates))
+    end_edit();
+  if(edit)
+    prepare_edit();
+
+  capture_grid.build(bodies, plates, BODY_SIZE, 3);
+
+  /* Centre weighted by the size of the charges, which stays inside the
+     scene even if the charges almost cancel out. */
+  float weight = 0;
+  far_centre = Vec2(0, 0);
+  far_charge = 0;
+  for(unsigned int i=0; i<bodies.size(); ++i)
+    {
+      far_centre += bodies[i].pos*fabs(bodies[i].charge);
+      weight += fabs(bodies[i].charge);
+      far_charge += bodies[i].charge;
+    }
+  for(unsigned int i=0; i<plates.size(); ++i)
+    {
+      far_centre += (plates[i].pos_a + plates[i].pos_b)*(0.5*fabs(plate_frames[i].charge));
+      weight += fabs(plate_frames[i].charge);
+      far_charge += plate_frames[i].charge;
+    }
+  if(weight > 0)
+    far_centre /= weight;
 
+  far_dipole = Vec2(0, 0);
+  far_radius = 0;
+  for(unsigned int i=0; i<bodies.size(); ++i)
+    {
+      far_dipole += (bodies[i].pos - far_centre)*bodies[i].charge;
+      far_radius = fmax(far_radius, bodies[i].pos.distance(far_centre));
+    }
+  for(unsigned int i=0; i<plates.size(); ++i)
+    {
+      far_dipole += ((plates[i].pos_a + plates[i].pos_b)*0.5 - far_centre)*plate_frames[i].charge;
+      far_radius = fmax(far_radius, fmax(plates[i].pos_a.distance(far_centre),
+                                         plates[i].pos_b.distance(far_centre)));
+    }
+
+  /* Far below the field anywhere a line may go, even well outside the
+     scene; only the surroundings of a saddle point are weaker. */
+  const float STAGNANT = 1e-6;
+  float size = fmax(far_radius, BODY_SIZE);
+  stagnant_field = STAGNANT*weight/(size*size);
+
+  if(options.barnes_hut)
+    body_tree.build(body_arrays);
+  else
+    body_tree.clear();
+
+  field_cache.clear();
+  if(options.field_grid && !edit && (!bodies.empty() || !plates.empty()))
+  {
+    std::vector<Vec2> points, segments;
+    for(unsigned int i=0; i<bodies.size(); ++i)
+      points.push_back(bodies[i].pos);
+    for(unsigned int i=0; i<plates.size(); ++i)
+    {
+      segments.push_back(plates[i].pos_a);
+      segments.push_back(plates[i].pos_b);
+    }
+
+    float x0, y0, x1, y1;
+    scene_bounds(x0, y0, x1, y1);
+    field_cache.build(x0, y0, x1, y1, points, segments,
+                      options.exact_radius, options.threads,
+                      [this](const Vec2& pos){return direct_force(pos, 1);});
+  }
+}
+
+/* Only notes what is edited, so that starting an edit never waits for
+   the grid. */
+void Simulation::assign_scene(const Simulation& other)
+{
+  options = other.options;
+  bodies = other.bodies;
+  plates = other.plates;
   result.clear();
 
-  Particle p;
-  const float START_VEL = 12.0;
-  const float STEPSIZE = 1;
+  edit = other.edit;
+  others = other.others;
+  edited_body = other.edited_body;
+  edited_plate = other.edited_plate;
+  edit_bodies = other.edit_bodies;
+  edit_plates = other.edit_plates;
+}
 
-  FluxLine l;
+void Simulation::begin_edit(int body, int plate)
+{
+  edit = std::make_shared<EditField>();
+  others.reset();
+  edited_body = body;
+  edited_plate = plate;
+  edit_bodies = bodies.size();
+  edit_plates = plates.size();
+}
 
+/* Samples the grid of the edit, unless a copy of the scene already did.
+   The grid covers the scene and the view, which is where the edited
+   object is likely to go; outside of it everything is evaluated
+   directly. */
+void Simulation::prepare_edit()
+{
+  std::lock_guard<std::mutex> lock(edit->mutex);
+  if(edit->grid)
+    {
+      others = edit->grid;
+      return;
+    }
+
+  profile_func_start(__PRETTY_FUNCTION__);
+
+  BodyArrays rest;
   for(unsigned int i=0; i<bodies.size(); ++i)
+    if(static_cast<int>(i) != edited_body)
+      rest.add(bodies[i].pos.get_x(), bodies[i].pos.get_y(), bodies[i].charge);
+
+  std::vector<PlateFrame> rest_plates;
+  for(unsigned int i=0; i<plates.size(); ++i)
+    if(static_cast<int>(i) != edited_plate)
+      {
+        PlateFrame frame;
+        frame.set(plates[i].pos_a.get_x(), plates[i].pos_a.get_y(),
+                  plates[i].pos_b.get_x(), plates[i].pos_b.get_y(), plates[i].charge);
+        rest_plates.push_back(frame);
+      }
+
+  float x0, y0, x1, y1;
+  scene_bounds(x0, y0, x1, y1);
+  if(options.view_x1 > options.view_x0)
     {
-      Body& body = bodies[i];
+      x0 = fmin(x0, options.view_x0 - options.view_margin);
+      y0 = fmin(y0, options.view_y0 - options.view_margin);
+      x1 = fmax(x1, options.view_x1 + options.view_margin);
+      y1 = fmax(y1, options.view_y1 + options.view_margin);
+    }
+
+  std::shared_ptr<SplitFieldGrid> grid = std::make_shared<SplitFieldGrid>();
+  grid->build(x0, y0, x1, y1, rest, rest_plates, options.exact_radius, options.threads);
+  edit->grid = others = grid;
+
+  profile_func_end(__PRETTY_FUNCTION__);
+}
+
+/* Copies the bodies and plates into the layout of the field kernels. */
+void Simulation::prepare_sources()
+{
+  body_arrays.clear();
+  for(unsigned int i=0; i<bodies.size(); ++i)
+    body_arrays.add(bodies[i].pos.get_x(), bodies[i].pos.get_y(), bodies[i].charge);
+
+  plate_frames.resize(plates.size());
+  for(unsigned int i=0; i<plates.size(); ++i)
+    plate_frames[i].set(plates[i].pos_a.get_x(), plates[i].pos_a.get_y(),
+                        plates[i].pos_b.get_x(), plates[i].pos_b.get_y(), plates[i].charge);
+}
+
+/* Bounding box of all bodies and plates plus a margin around it. */
+void Simulation::scene_bounds(float& x0, float& y0, float& x1, float& y1) const
+{
+  x0 = y0 = 1e30;
+  x1 = y1 = -1e30;
+  for(unsigned int i=0; i<bodies.size(); ++i)
+  {
+    x0 = fmin(x0, bodies[i].pos.get_x());
+    y0 = fmin(y0, bodies[i].pos.get_y());
+    x1 = fmax(x1, bodies[i].pos.get_x());
+    y1 = fmax(y1, bodies[i].pos.get_y());
+  }
+  for(unsigned int i=0; i<plates.size(); ++i)
+  {
+    x0 = fmin(x0, fmin(plates[i].pos_a.get_x(), plates[i].pos_b.get_x()));
+    y0 = fmin(y0, fmin(plates[i].pos_a.get_y(), plates[i].pos_b.get_y()));
+    x1 = fmax(x1, fmax(plates[i].pos_a.get_x(), plates[i].pos_b.get_x()));
+    y1 = fmax(y1, fmax(plates[i].pos_a.get_y(), plates[i].pos_b.get_y()));
+  }
+
+  float margin = 0.1*fmax(x1 - x0, y1 - y0) + 50;
+  x0 -= margin;
+  y0 -= margin;
+  x1 += margin;
+  y1 += margin;
+}
+
+FieldError Simulation::field_error(unsigned int samples)
+{
+  prepare();
+
+  FieldError err;
+  err.samples = 0;
+  err.max_relative = err.mean_relative = err.rms_relative = err.max_angle = 0;
+
+  if(bodies.empty() && plates.empty())
+    return err;
+
+  float x0, y0, x1, y1;
+  scene_bounds(x0, y0, x1, y1);
+
+  std::minstd_rand rng(1);
+  std::uniform_real_distribution<float> rx(x0, x1), ry(y0, y1);
+
+  double sum = 0, sum2 = 0;
+  for(unsigned int n=0; n<samples; ++n)
+  {
+    Vec2 pos(rx(rng), ry(rng));
+
+    /* The field is singular at the bodies themselves. */
+    bool inside = false;
+    for(unsigned int i=0; i<bodies.size() && !inside; ++i)
+      inside = (pos.distance(bodies[i].pos) <= BODY_SIZE);
+    if(inside)
+      continue;
+
+    Vec2 exact = force_at(pos, 1);
+    Vec2 approx = trace_force(pos, 1);
+    float len = exact.length();
+    if(!(len > 0) || !isfinite(len))
+      continue;
+
+    float rel = (approx - exact).length()/len;
+
+    /* In double, from both the sine and the cosine: acos() of a float
+       cosine cannot resolve angles below about 0.03 degrees. */
+    double ex = exact.get_x(), ey = exact.get_y(), ax = approx.get_x(), ay = approx.get_y();
+    float angle = atan2(fabs(ex*ay - ey*ax), ex*ax + ey*ay)*180/PI;
+
+    err.samples++;
+    err.max_relative = fmax(err.max_relative, rel);
+    err.max_angle = fmax(err.max_angle, angle);
+    sum += rel;
+    sum2 += rel*rel;
+  }
+
+  if(err.samples > 0)
+  {
+    err.mean_relative = sum/err.samples;
+    err.rms_relative = sqrt(sum2/err.samples);
+  }
+
+  return err;
+}
+
+static const float START_VEL = 12.0;
+
+void Simulation::build_seeds(std::vector<Seed>& seeds) const
+{
+  if(options.seeding != SEEDING_CHARGE)
+    flux_seeds(seeds);
+  else
+    charge_seeds(seeds);
+}
+
+void Simulation::charge_seeds(std::vector<Seed>& seeds) const
+{
+  Seed seed;
+
+  for(unsigned int i=0; i<bodies.size(); ++i)
+    {
+      const Body& body = bodies[i];
       if(body.charge == 0)
         continue;
-      float n = 4*fabs(body.charge);
+      float n = 4*fabs(body.charge)*options.line_density;
       for(float angle=0; angle<(2*PI); angle+=(2*PI/n))
         {
-          p.n=0;
-          l.clear();
-
-          p.pos = body.pos;
-          l.add(p.pos);
-          
-          p.pos += Vec2(cos(angle),sin(angle))*START_VEL;
-          p.charge = body.charge;
-          l.add(p.pos);
-          while(step(p, STEPSIZE))
-            {
-              l.add(p.pos);
-            }
-          l.add(p.pos);
-
-          result.push_back(l);
+          seed.origin = body.pos;
+          seed.start = body.pos + Vec2(cos(angle),sin(angle))*START_VEL;
+          seed.charge = body.charge;
+          seed.body = i;
+          seed.spread = 2*PI/n;
+          seeds.push_back(seed);
         }
     }
 
   for(unsigned int i=0; i<plates.size(); ++i)
     {
-      PlateBody& plate = plates[i];
+      const PlateBody& plate = plates[i];
       if(plate.charge == 0)
         continue;
-      float n = 2*fabs(plate.charge);
+      float n = 2*fabs(plate.charge)*options.line_density;
       Vec2 diff = plate.pos_b - plate.pos_a;
       for(float pos=0; pos<=1.0; pos+=1/n)
         {
@@ -286,27 +841,730 @@ void Simulation::run()
           do
           {
             s *= -1;
-            p.n=0;
-            l.clear();
 
-            p.pos = plate.pos_a + diff*pos;
-            l.add(p.pos);
+            seed.origin = plate.pos_a + diff*pos;
+            seed.start = seed.origin + Vec2(diff.get_y(), -diff.get_x()).normalize()*(s*5);
+            seed.charge = plate.charge;
+            seed.body = -1;
+            seed.spread = 0;
+            seeds.push_back(seed);
+          } while(s == -1);
+        }
+    }
+}
 
-            p.pos += Vec2(diff.get_y(), -diff.get_x()).normalize()*(s*5);
-            p.charge = plate.charge;
+/* Shares out the line budget by flux.  The flux of a body or plate is
+   its charge, so a plate gets as many lines as SEEDING_CHARGE starts
+   from it, not fewer the longer it is. */
+void Simulation::flux_seeds(std::vector<Seed>& seeds) const
+{
+  const float LINES_PER_FLUX = 4;
+  const float ISOLATION = 2;
+  const float SKIP_ANGLE = PI/2;
 
-            l.add(p.pos);
-            while(step(p, STEPSIZE))
+  const unsigned int n_bodies = bodies.size();
+  std::vector<float> flux(n_bodies + plates.size());
+  float total = 0;
+  for(unsigned int i=0; i<n_bodies; ++i)
+    total += flux[i] = fabs(bodies[i].charge);
+  for(unsigned int i=0; i<plates.size(); ++i)
+    total += flux[n_bodies + i] = fabs(plates[i].charge);
+  if(!(total > 0))
+    return;
+
+  float lines = (options.line_budget > 0) ? options.line_budget : LINES_PER_FLUX*total;
+  unsigned int budget = static_cast<unsigned int>(lines*options.line_density + 0.5);
+
+  /* Largest remainder, so the counts add up to the budget exactly */
+  std::vector<unsigned int> count(flux.size());
+  std::vector<std::pair<float, unsigned int> > rest(flux.size());
+  unsigned int given = 0;
+  for(unsigned int k=0; k<flux.size(); ++k)
+    {
+      float share = budget*flux[k]/total;
+      count[k] = static_cast<unsigned int>(share);
+      given += count[k];
+      rest[k] = std::make_pair(count[k] - share, k);
+    }
+  std::sort(rest.begin(), rest.end());
+  for(unsigned int k=0; given < budget && k < rest.size(); ++k, ++given)
+    count[rest[k].second]++;
+
+  Seed seed;
+
+  for(unsigned int i=0; i<n_bodies; ++i)
+    {
+      const Body& body = bodies[i];
+      if(count[i] == 0)
+        continue;
+
+      /* A close pair of opposite charges, with everything else far
+         away, shares nearly all flux of the weaker one.  The stronger
+         one traces those lines, the weaker one skips the half facing
+         it. */
+      unsigned int nearest = 0;
+      float d1 = 1e30, d2 = 1e30;
+      for(unsigned int k=0; k<flux.size(); ++k)
+        {
+          if(k == i || flux[k] == 0)
+            continue;
+          float d = (k < n_bodies) ? body.pos.distance(bodies[k].pos)
+            : sqrt(segment_distance2(body.pos, plates[k - n_bodies].pos_a, plates[k - n_bodies].pos_b));
+          if(d < d1)
             {
-              l.add(p.pos);
+              d2 = d1;
+              d1 = d;
+              nearest = k;
             }
+          else if(d < d2)
+            d2 = d;
+        }
+
+      bool skip = d1 < 1e30 && d2 >= ISOLATION*d1 && nearest < n_bodies
+        && bodies[nearest].charge*body.charge < 0
+        && (flux[nearest] > flux[i] || (flux[nearest] == flux[i] && nearest < i));
+      Vec2 towards;
+      if(skip)
+        towards = (bodies[nearest].pos - body.pos).normalize();
+
+      for(unsigned int k=0; k<count[i]; ++k)
+        {
+          float angle = 2*PI*k/count[i];
+          Vec2 dir(cos(angle), sin(angle));
+          if(skip && dir.get_x()*towards.get_x() + dir.get_y()*towards.get_y() > cos(SKIP_ANGLE) + 1e-6)
+            continue;
+
+          seed.origin = body.pos;
+          seed.start = body.pos + dir*START_VEL;
+          seed.charge = body.charge;
+          seed.body = i;
+          seed.spread = 2*PI/count[i];
+          seeds.push_back(seed);
+        }
+    }
+
+  /* Plates alternate between both sides, spread evenly along them. */
+  for(unsigned int i=0; i<plates.size(); ++i)
+    {
+      const PlateBody& plate = plates[i];
+      unsigned int n = count[n_bodies + i];
+      unsigned int per_side = (n + 1)/2;
+      Vec2 diff = plate.pos_b - plate.pos_a;
+      Vec2 normal = Vec2(diff.get_y(), -diff.get_x()).normalize();
+      for(unsigned int k=0; k<n; ++k)
+        {
+          float s = (k % 2) ? 5 : -5;
+          seed.origin = plate.pos_a + diff*((k/2 + 0.5f)/per_side);
+          seed.start = seed.origin + normal*s;
+          seed.charge = plate.charge;
+          seed.body = -1;
+          seed.spread = 0;
+          seeds.push_back(seed);
+        }
+    }
+}
+
+/* Adds points on the curve of the step that brought `p' from `a', so
+   long steps through a bend are not drawn as a single visible chord.
+   The curve is the dense output the integrator left in `p.dense':
+   the position at the fraction t of the step is
+   a + t*(c0 + t*(c1 + t*(c2 + t*c3))), which unlike a Hermite curve
+   through the ends stays on the solution of the step. */
+static void add_curve(FluxLines& l, const Vec2& a, const Particle& p)
+{
+  const float MAX_SAGITTA = 0.25;
+  const int MAX_PIECES = 16;
+
+  const Vec2 *c = p.dense;
+  const Vec2 chord = p.pos - a;
+  float len = chord.length();
+  float start = c[0].length();
+  if(!(len > 0) || !(start > 0))
+    return;
+
+  auto at = [c](float t){return (c[0] + (c[1] + (c[2] + c[3]*t)*t)*t)*t;};
+
+  /* How far the curve is off the chord: the turn between the ends
+     gives it for a plain arc, but a step that bends one way and back
+     ends as it started, so its distance from the chord at the quarters
+     counts as well. */
+  float sagitta = len*(p.dir - c[0]/start).length()/8;
+  for(int i=1; i<4; ++i)
+    {
+      Vec2 q = at(i/4.0f);
+      sagitta = fmax(sagitta, fabs(q.get_x()*chord.get_y() - q.get_y()*chord.get_x())/len);
+    }
+
+  /* The sagitta of a chord shrinks with the square of its length. */
+  int pieces = static_cast<int>(ceil(sqrt(sagitta/MAX_SAGITTA)));
+  if(pieces > MAX_PIECES)
+    pieces = MAX_PIECES;
+
+  for(int i=1; i<pieces; ++i)
+    l.add(a + at(static_cast<float>(i)/pieces));
+}
+
+/* Appends the line of `seed' to `l'.  A line that leaves the view and
+   comes back is stored as two lines, so it is not drawn straight across
+   the gap. */
+LineEnd Simulation::trace(const Seed& seed, FluxLines& l) const
+{
+  LineEnd end = {-1, 0, END_NONE};
+
+  const float STEPSIZE = 1;
+  const bool curved = Integrator::get(options.integrator).long_steps();
+
+  Particle p;
+
+  l.add(seed.origin);
+
+  p.pos = seed.start;
+  p.charge = seed.charge;
+  l.add(p.pos);
+
+  for(;;)
+    {
+      Vec2 last = p.pos;
+      while(step(p, STEPSIZE))
+        {
+          if(curved)
+            add_curve(l, last, p);
+          l.add(p.pos);
+          last = p.pos;
+        }
+      l.add(p.pos);
+
+      if(options.simplify > 0)
+        l.simplify_line(options.simplify);
+      l.end_line();
+
+      end.reason = p.end;
+
+      /* The last point outside the body gives the angle */
+      if(p.hit >= 0)
+        {
+          Vec2 d = last - bodies[p.hit].pos;
+          end.body = p.hit;
+          end.angle = atan2(d.get_y(), d.get_x());
+        }
+
+      if(!p.jump)
+        break;
+
+      /* Start over at the point where the line comes back */
+      p.jump = p.seen = false;
+      p.pos = p.resume;
+      p.dir = p.moved = Vec2(0, 0);
+      p.h = 0;
+      p.reversals = 0;
+      l.add(p.pos);
+    }
+
+  return end;
+}
+
+unsigned long Simulation::follow(const std::vector<Vec2>& starts, float charge,
+                                unsigned int max_steps, FluxLines *l)
+{
+  prepare();
+
+  const bool curved = Integrator::get(options.integrator).long_steps();
+
+  unsigned long steps = 0;
+  for(unsigned int i=0; i<starts.size(); ++i)
+    {
+      Particle p;
+      p.pos = starts[i];
+      p.charge = charge;
+      if(l)
+        l->add(p.pos);
+
+      unsigned int n = 0;
+      Vec2 last = p.pos;
+      while(n < max_steps && step(p, 1))
+        {
+          n++;
+          if(l)
+            {
+              if(curved)
+                add_curve(*l, last, p);
+              l->add(p.pos);
+            }
+          last = p.pos;
+        }
+
+      /* The step that ended the line, into a body say, as run() draws it */
+      if(l && n < max_steps)
+        l->add(p.pos);
+      if(l)
+        l->end_line();
+      steps += n;
+    }
+
+  return steps;
+}
+
+static bool arrival_less(const LineEnd& a, const LineEnd& b)
+{
+  return a.body < b.body || (a.body == b.body && a.angle < b.angle);
+}
+
+/* Moves the seeds of positive charges to the front, without changing
+   their order otherwise, and returns how many there are. */
+unsigned int Simulation::order_seeds()
+{
+  std::stable_partition(seeds.begin(), seeds.end(),
+                        [](const Seed& s){return s.charge > 0;});
+
+  unsigned int n = 0;
+  while(n < seeds.size() && seeds[n].charge > 0)
+    n++;
+  return n;
+}
+
+/* Marks the seeds of negative bodies from `n_first' on as skipped if a
+   line of the first seeds arrived at that body less than half a seed
+   spacing away from them; it already shows the line the seed would
+   trace backwards. */
+void Simulation::skip_arrived(unsigned int n_first)
+{
+  arrivals.clear();
+  for(unsigned int i=0; i<n_first; ++i)
+    if(slots[i].end.body >= 0)
+      arrivals.push_back(slots[i].end);
+  std::sort(arrivals.begin(), arrivals.end(), arrival_less);
+
+  for(unsigned int i=n_first; i<seeds.size(); ++i)
+    {
+      const Seed& seed = seeds[i];
+      if(seed.body < 0 || arrivals.empty())
+        continue;
+
+      Vec2 d = seed.start - seed.origin;
+      LineEnd key = {seed.body, static_cast<float>(atan2(d.get_y(), d.get_x())), END_BODY};
+      float limit = 0.5*seed.spread;
+
+      /* The closest arrivals above and below the angle, wrapping around
+         at +-pi */
+      std::vector<LineEnd>::const_iterator lo, hi, above;
+      lo = std::lower_bound(arrivals.begin(), arrivals.end(), LineEnd{seed.body, -4, END_BODY}, arrival_less);
+      hi = std::lower_bound(arrivals.begin(), arrivals.end(), LineEnd{seed.body + 1, -4, END_BODY}, arrival_less);
+      if(lo == hi)
+        continue;
+      above = std::lower_bound(lo, hi, key, arrival_less);
+
+      float up = (above != hi) ? above->angle - key.angle : lo->angle + 2*PI - key.angle;
+      float down = (above != lo) ? key.angle - (above - 1)->angle : key.angle - ((hi - 1)->angle - 2*PI);
+      slots[i].skip = fmin(up, down) < limit;
+    }
+}
+
+/* Counts why the lines of the seeds ended; skipped seeds are left
+   out. */
+void Simulation::count_ends()
+{
+  std::fill(end_counts, end_counts + END_REASONS_NUM, 0);
+  for(unsigned int i=0; i<slots.size(); ++i)
+    if(!slots[i].skip)
+      end_counts[slots[i].end.reason]++;
+}
+
+/* How far along the segment, from 0 to 1, it stays farther than
+   `dist' from all lines traced so far; above 1 if it does all the
+   way. */
+float Simulation::crowded(const Vec2& from, const Vec2& to, float dist) const
+{
+  float len = from.distance(to);
+  unsigned int n = static_cast<unsigned int>(ceil(2*len/dist));
+  for(unsigned int i=1; i<=n; ++i)
+    {
+      Vec2 q = from + (to - from)*(static_cast<float>(i)/n);
+      if(occupancy.occupied(q.get_x(), q.get_y(), dist))
+        return static_cast<float>(i - 1)/n;
+    }
+  return 2;
+}
+
+/* Adds the points of the line from `start' to the open line of `l' and
+   stops where it comes closer than `dist' to an earlier line, or at the
+   edge of the area.  The first `exempt' units are not checked, for the
+   lines that all start at the same body.  Long steps are cut off at
+   the first crowded point, not before the step, so they leave no
+   gaps.  Returns why the line stopped. */
+EndReason Simulation::trace_spaced(const Vec2& start, float charge, float exempt, float dist,
+                              FluxLines& l) const
+{
+  const bool curved = Integrator::get(options.integrator).long_steps();
+
+  Particle p;
+  p.pos = start;
+  p.charge = charge;
+
+  Vec2 last = p.pos;
+  for(;;)
+    {
+      if(!step(p, 1))
+        {
+          if(!p.jump)
             l.add(p.pos);
+          return p.end;
+        }
+      if(!occupancy.inside(p.pos.get_x(), p.pos.get_y()))
+        return END_VIEW;
 
-            result.push_back(l);
-          } while(s == -1);
+      unsigned int first = l.open_size();
+      if(curved)
+        add_curve(l, last, p);
+      l.add(p.pos);
+
+      if(p.s > exempt)
+        for(unsigned int k=first; k<l.open_size(); ++k)
+          {
+            Vec2 a = l.open_point(k - 1), b = l.open_point(k);
+            float t = crowded(a, b, dist);
+            if(t <= 1)
+              {
+                l.truncate_line(k);
+                if(t > 0)
+                  l.add(a + (b - a)*t);
+                return END_CROWDED;
+              }
+          }
+
+      last = p.pos;
+    }
+}
+
+/* Completes the open line of `l', marks it in the occupancy grid with
+   points at most `spacing' apart and hands it to `each'. */
+bool Simulation::end_spaced(FluxLines& l, float spacing,
+                            const std::function<bool(const FluxLine&)>& each)
+{
+  if(l.open_size() < 2)
+    {
+      l.truncate_line(0);
+      return true;
+    }
+
+  if(options.simplify > 0)
+    l.simplify_line(options.simplify);
+  l.end_line();
+
+  FluxLine line = l[l.size() - 1];
+  occupancy.add(line[0].get_x(), line[0].get_y());
+  for(unsigned int k=1; k<line.size; ++k)
+    {
+      const Vec2& a = line[k-1];
+      const Vec2& b = line[k];
+      unsigned int n = static_cast<unsigned int>(ceil(a.distance(b)/spacing));
+      for(unsigned int i=1; i<=n; ++i)
+        {
+          Vec2 q = a + (b - a)*(static_cast<float>(i)/n);
+          occupancy.add(q.get_x(), q.get_y());
         }
     }
 
- profile_func_end(__PRETTY_FUNCTION__);
+  return each(line);
 }
+
+/* Evenly spaced lines after Jobard and Lefer: the lines of the bodies
+   and plates are traced one after the other, each ending where it gets
+   too close to the ones before.  Then new lines are started one
+   separation to either side of every line, wherever that is still free
+   space, and traced both ways.  The area to fill bounds the work, not
+   the amount of charge.  Runs on one thread, as every line depends on
+   all lines before it. */
+void Simulation::even_lines(FluxLines& l, const std::function<bool(const FluxLine&)>& each)
+{
+  const float sep = options.separation/sqrt(fmax(options.line_density, 0.01f));
+  const float test = 0.5*sep;
+  const float spacing = 0.25*test;
+
+  float x0, y0, x1, y1;
+  if(options.view_x1 > options.view_x0 && options.view_y1 > options.view_y0)
+    {
+      x0 = options.view_x0 - options.view_margin;
+      y0 = options.view_y0 - options.view_margin;
+      x1 = options.view_x1 + options.view_margin;
+      y1 = options.view_y1 + options.view_margin;
+    }
+  else
+    scene_bounds(x0, y0, x1, y1);
+
+  occupancy.build(x0, y0, x1, y1, sep);
+  l.clear();
+  std::fill(end_counts, end_counts + END_REASONS_NUM, 0);
+
+  seeds.clear();
+  flux_seeds(seeds);
+
+  for(unsigned int i=0; i<seeds.size(); ++i)
+    {
+      l.add(seeds[i].origin);
+      l.add(seeds[i].start);
+      end_counts[trace_spaced(seeds[i].start, seeds[i].charge, 2*sep, test, l)]++;
+      if(!end_spaced(l, spacing, each))
+        return;
+    }
+
+  /* `l' grows while it is walked, so points are copied, not referenced */
+  for(unsigned int i=0; i<l.size(); ++i)
+    {
+      float along = 0;
+      for(unsigned int k=1; k<l[i].size; ++k)
+        {
+          Vec2 a = l[i][k-1], b = l[i][k];
+          float len = a.distance(b);
+          along += len;
+          if(along < sep || !(len > 0))
+            continue;
+          along = 0;
+
+          Vec2 normal = Vec2(a.get_y() - b.get_y(), b.get_x() - a.get_x())/len;
+          for(int side=-1; side<=1; side+=2)
+            {
+              Vec2 c = b + normal*(side*sep);
+              if(!occupancy.inside(c.get_x(), c.get_y())
+                 || occupancy.occupied(c.get_x(), c.get_y(), 0.99*sep)
+                 || absorbed(c, c))
+                continue;
+
+              l.add(c);
+              end_counts[trace_spaced(c, -1, 0, test, l)]++;
+              l.reverse_line();
+              end_counts[trace_spaced(c, 1, 0, test, l)]++;
+              if(!end_spaced(l, spacing, each))
+                return;
+            }
+        }
+    }
+}
+
+void Simulation::run()
+{
+  profile_func_start(__PRETTY_FUNCTION__);
+
+  prepare();
+
+  if(options.seeding == SEEDING_EVEN)
+    {
+      even_lines(result, [](const FluxLine&){return true;});
+      profile_func_end(__PRETTY_FUNCTION__);
+      return;
+    }
+
+  seeds.clear();
+  build_seeds(seeds);
+  unsigned int n_first = order_seeds();
+
+  /* Every thread appends to its own arena; afterwards the lines are
+     gathered in seed order, so the result does not depend on the
+     number of threads. */
+  unsigned int threads = parallel_threads(seeds.size(), options.threads);
+  if(arenas.size() < threads)
+    arenas.resize(threads);
+  for(unsigned int t=0; t<threads; ++t)
+    arenas[t].clear();
+  slots.assign(seeds.size(), Slot());
+
+  auto trace_slot = [&](unsigned int i, unsigned int t)
+    {
+      Slot& s = slots[i];
+      s.thread = t;
+      s.first = arenas[t].size();
+      s.count = 0;
+      if(s.skip)
+        return;
+      s.end = trace(seeds[i], arenas[t]);
+      s.count = arenas[t].size() - s.first;
+    };
+
+  /* The positive seeds first, so the negative ones know where their
+     lines arrived. */
+  parallel_for_thread(n_first, threads, trace_slot);
+  if(options.skip_arrived)
+    skip_arrived(n_first);
+  parallel_for_thread(seeds.size() - n_first, threads,
+                      [&](unsigned int i, unsigned int t){trace_slot(n_first + i, t);});
+  count_ends();
+
+  unsigned int n_lines = 0, n_points = 0;
+  for(unsigned int t=0; t<threads; ++t)
+    {
+      n_lines += arenas[t].size();
+      n_points += arenas[t].n_points();
+    }
+
+  result.clear();
+  result.reserve(n_lines, n_points);
+  for(unsigned int i=0; i<seeds.size(); ++i)
+    for(unsigned int k=0; k<slots[i].count; ++k)
+      result.append(arenas[slots[i].thread][slots[i].first + k]);
+
+  profile_func_end(__PRETTY_FUNCTION__);
+}
+
+bool Simulation::stream(const std::atomic<bool>& cancel,
+                        const std::function<void(const FluxLine&)>& done)
+{
+  prepare();
+
+  if(options.seeding == SEEDING_EVEN)
+    {
+      if(arenas.empty())
+        arenas.resize(1);
+      even_lines(arenas[0],
+                 [&](const FluxLine& l)
+                 {
+                   if(cancel)
+                     return false;
+                   done(l);
+                   return true;
+                 });
+      return !cancel;
+    }
+
+  seeds.clear();
+  build_seeds(seeds);
+  unsigned int n_first = order_seeds();
+
+  unsigned int threads = parallel_threads(seeds.size(), options.threads);
+  if(arenas.size() < threads)
+    arenas.resize(threads);
+  slots.assign(seeds.size(), Slot());
+
+  auto trace_slot = [&](unsigned int i, unsigned int t)
+    {
+      if(cancel || slots[i].skip)
+        return;
+
+      FluxLines& l = arenas[t];
+      l.clear();
+      slots[i].end = trace(seeds[i], l);
+      for(unsigned int k=0; k<l.size() && !cancel; ++k)
+        done(l[k]);
+    };
+
+  parallel_for_thread(n_first, threads, trace_slot);
+  if(options.skip_arrived && !cancel)
+    skip_arrived(n_first);
+  parallel_for_thread(seeds.size() - n_first, threads,
+                      [&](unsigned int i, unsigned int t){trace_slot(n_first + i, t);});
+  count_ends();
+
+  return !cancel;
+}
+
+void Simulation::sample_potential(float x0, float y0, float x1, float y1, float cell)
+{
+  profile_func_start(__PRETTY_FUNCTION__);
+
+  prepare_sources();
+  potential.build(x0, y0, x1, y1, cell, options.threads,
+                  [this](float x, float y)
+                  {
+                    float u = body_potential(body_arrays, x, y);
+                    for(unsigned int i=0; i<plate_frames.size(); ++i)
+                      u += plate_potential(plate_frames[i], x, y);
+                    return u;
+                  });
+
+  profile_func_end(__PRETTY_FUNCTION__);
+}
+
+void Simulation::equipotentials(float spacing, FluxLines& l)
+{
+  /* Levels right next to a charge are left out by the grid anyway */
+  const float MAX_LEVELS = 10000;
+
+  if(potential.empty() || !(spacing > 0))
+    return;
+
+  float first = ceil(fmax(potential.get_min()/spacing, -0.5*MAX_LEVELS));
+  float last = floor(fmin(potential.get_max()/spacing, 0.5*MAX_LEVELS));
+
+  levels.clear();
+  for(float k=first; k<=last; ++k)
+    levels.push_back(k*spacing);
+
+  potential.contours(levels, options.simplify, l);
+}
+
+void Simulation::swap_potential(PotentialGrid& grid)
+{
+  std::swap(potential, grid);
+}
+
+/* The log of the field strength, or the potential, from the arrays
+   of prepare_sources() */
+FieldMap::ValueFunc Simulation::heatmap_value(HeatmapType type) const
+{
+  if(type == HEATMAP_POTENTIAL)
+    return [this](float x, float y)
+      {
+        float u = body_potential(body_arrays, x, y);
+        for(unsigned int i=0; i<plate_frames.size(); ++i)
+          u += plate_potential(plate_frames[i], x, y);
+        return u;
+      };
+
+  return [this](float x, float y)
+    {
+      float fx, fy;
+      body_field(body_arrays, x, y, fx, fy);
+      for(unsigned int i=0; i<plate_frames.size(); ++i)
+        plate_field_fast(plate_frames[i], x, y, fx, fy);
+      /* Right on a body the kernel gives NaN */
+      float f2 = fx*fx + fy*fy;
+      return isnan(f2) ? HUGE_VALF : 0.5f*log(f2);
+    };
+}
+
+void Simulation::sample_heatmap(FieldMap& map, HeatmapType type, unsigned int width, unsigned int height)
+{
+  profile_func_start(__PRETTY_FUNCTION__);
+
+  prepare_sources();
+  map.build(type, width, height, options.threads, heatmap_value(type));
+
+  profile_func_end(__PRETTY_FUNCTION__);
+}
+
+void Simulation::update_heatmap(FieldMap& map, const std::vector<Vec2>& near, float radius)
+{
+  profile_func_start(__PRETTY_FUNCTION__);
+
+  prepare_sources();
+  map.update(near, radius, options.threads, heatmap_value(map.get_type()));
+
+  profile_func_end(__PRETTY_FUNCTION__);
+}
+
+void FluxLines::append(const FluxLine& l)
+{
+  points.insert(points.end(), l.points, l.points + l.size);
+  end_line();
+}
+
+void FluxLines::simplify_line(float tolerance)
+{
+  unsigned int first = offsets.back();
+  unsigned int n = simplify_polyline(points.data() + first, points.size() - first,
+                                     tolerance, stack);
+  points.resize(first + n);
+}
+
+void FluxLines::reverse_line()
+{
+  std::reverse(points.begin() + offsets.back(), points.end());
+}
+
+void FluxLines::append(const FluxLines& l)
+{
+  unsigned int base = points.size();
+  points.insert(points.end(), l.points.begin(), l.points.end());
+  for(unsigned int i=1; i<l.offsets.size(); ++i)
+    offsets.push_back(base + l.offsets[i]);
+}
+
 }
@@ -22,10 +22,29 @@
 #define _SIMULATION_H_
 
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
 #include <math.h>
 
+#include "FieldKernel.h"
+#include "QuadTree.h"
+#include "FieldGrid.h"
+#include "SplitFieldGrid.h"
+#include "CaptureGrid.h"
+#include "OccupancyGrid.h"
+#include "PotentialGrid.h"
+#include "FieldMap.h"
+#include "VisitedCells.h"
+#include "Integrator.h"
+
 const float PI = 3.14159265358979;
 
+/* Bodies a scene holds at most; the canvas numbers the plates from
+   here on. */
+const int MAX_BODIES = 1 << 20;
+
 namespace Elfelli
 {
 
@@ -35,13 +54,12 @@ public:
   Vec2();
   Vec2(float x, float y);
 
-  Vec2 operator=(const Vec2& v);
-  Vec2 operator+(const Vec2& v);
-  Vec2 operator-(const Vec2& v);
-  Vec2 operator*(float c);
-  Vec2 operator/(float c);
+  Vec2 operator+(const Vec2& v) const;
+  Vec2 operator-(const Vec2& v) const;
+  Vec2 operator*(float c) const;
+  Vec2 operator/(float c) const;
 
-  Vec2 operator-();
+  Vec2 operator-() const;
 
   void operator+=(const Vec2& v);
   void operator-=(const Vec2& v);
@@ -76,9 +94,24 @@ struct PlateBody
   float charge;
 };
 
+/* Why a line stopped */
+enum EndReason
+  {
+    END_NONE = 0,     // still running, or never started
+    END_BODY,         // ran into a body or plate
+    END_LIMIT,        // took too many steps or went too far
+    END_VIEW,         // left the view for good, or jumped
+    END_STAGNANT,     // the field vanishes, e.g. at a saddle point
+    END_OSCILLATING,  // kept turning around on the spot
+    END_LOOP,         // came the same way through the same cells again
+    END_CROWDED,      // came too close to another line (SEEDING_EVEN)
+    END_REASONS_NUM
+  };
+
 struct Particle
 {
-  Particle(){n=0;};
+  Particle(){n=0;s=0;h=0;field=0;dir=moved=Vec2(0,0);seen=jump=false;hit=-1;
+    reversals=revisits=0;end=END_NONE;};
   void move(){pos+=vel;};
 
   Vec2 pos;
@@ -86,22 +119,206 @@ struct Particle
 
   int n;
   float charge;
+
+  float s;    // arc length travelled so far
+  float h;    // next step length of adaptive integrators, 0 before the first step
+
+  bool seen;      // has been in view since the start or the last jump
+  bool jump;      // the line ended outside the view and comes back at `resume'
+  Vec2 resume;
+  int hit;        // body the line ran into, -1 for none
+  Vec2 dir;   // direction at `pos' as left by the last step
+  Vec2 dense[4];  // last step of adaptive integrators as a polynomial, see add_curve()
+  float field;    // strength of the field at `pos'
+
+  /* Loop detection: the last step, how many steps in a row turned
+     around, and how often the line came back the same way. */
+  Vec2 moved;
+  int reversals, revisits;
+  VisitedCells visited;
+
+  EndReason end;
 };
 
+/* Read-only view of one line inside a FluxLines buffer; only valid as
+   long as the buffer is not changed. */
 struct FluxLine
 {
+  FluxLine(const Vec2 *p, unsigned int n){points=p;size=n;};
+
+  const Vec2& operator[](unsigned int i) const{return points[i];};
+
+  const Vec2 *points;
+  unsigned int size;
+};
+
+/* Any number of flux lines stored back to back in a single point
+   buffer: line i is made of the points offsets[i] to offsets[i+1]-1.
+   Clearing keeps the memory, so refilling a buffer allocates nothing
+   once it has grown large enough. */
+class FluxLines
+{
+public:
+  FluxLines(){offsets.push_back(0);};
+
+  void clear(){points.clear();offsets.resize(1);};
+  void reserve(unsigned int lines, unsigned int n_points){offsets.reserve(lines+1);points.reserve(n_points);};
+
+  unsigned int size() const{return offsets.size()-1;};
+  bool empty() const{return size() == 0;};
+  unsigned int n_points() const{return offsets.back();};
+  unsigned int bytes() const{return points.capacity()*sizeof(Vec2) + offsets.capacity()*sizeof(unsigned int);};
+
+  FluxLine operator[](unsigned int i) const
+  {return FluxLine(points.data() + offsets[i], offsets[i+1] - offsets[i]);};
+
+  /* Points are added to an open line that end_line() completes. */
   void add(const Vec2& p){points.push_back(p);};
-  void clear(){points.clear();};
+  void end_line(){offsets.push_back(points.size());};
+
+  /* Drops the points of the open line that are within `tolerance' of
+     the simplified line, see simplify_polyline(). */
+  void simplify_line(float tolerance);
 
+  /* Points of the open line so far */
+  unsigned int open_size() const{return points.size() - offsets.back();};
+  const Vec2& open_point(unsigned int i) const{return points[offsets.back() + i];};
+
+  /* Turns the open line around, or keeps only its first n points. */
+  void reverse_line();
+  void truncate_line(unsigned int n){points.resize(offsets.back() + n);};
+
+  void append(const FluxLine& l);
+  void append(const FluxLines& l);
+
+  void swap(FluxLines& l){points.swap(l.points);offsets.swap(l.offsets);};
+
+private:
   std::vector<Vec2> points;
+  std::vector<unsigned int> offsets;
+  std::vector<unsigned int> stack;   // scratch space of simplify_line()
+};
+
+/* Starting point of a single flux line: the line begins at `origin'
+   (the centre of the emitting body or a point on a plate) and the
+   first integration step starts from `start'. */
+struct Seed
+{
+  Vec2 origin;
+  Vec2 start;
+  float charge;
+
+  int body;       // emitting body, -1 for plates
+  float spread;   // angle between neighbouring seeds of the body
+};
+
+/* Where a traced line ended: the body it ran into (-1 for none) and
+   the angle around that body at which it arrived, and why. */
+struct LineEnd
+{
+  int body;
+  float angle;
+  EndReason reason;
+};
+
+enum SeedingType
+  {
+    SEEDING_CHARGE = 0,  // 4 lines per unit of charge, evenly in angle
+    SEEDING_FLUX,        // a line budget shared out by flux
+    SEEDING_EVEN         // evenly spaced lines all over the scene
+  };
+
+struct TraceOptions
+{
+  TraceOptions();
+
+  /* Number of threads used for tracing; 0 means hardware_threads(),
+     1 traces everything on the calling thread. */
+  unsigned int threads;
+
+  /* Evaluate the point charges with the vectorized kernel instead of
+     the reference force_at(). */
+  bool vectorize;
+
+  /* Approximate the point charges with a Barnes-Hut tree; cells are
+     expanded when size/distance < theta.  Takes precedence over
+     `vectorize'. */
+  bool barnes_hut;
+  float theta;
+
+  /* Sample the field from a grid filled once per run(), except within
+     `exact_radius' of a body or plate. */
+  bool field_grid;
+  float exact_radius;
+
+  /* Method used to follow the field and, for adaptive methods, the
+     allowed local error per unit of arc length. */
+  IntegratorType integrator;
+  float tolerance;
+
+  /* Fraction of the usual number of lines per body or plate, and the
+     most steps a single line may take (0 for no limit).  Both are only
+     lowered for quick previews. */
+  float line_density;
+  unsigned int max_steps;
+
+  /* Where lines start, by default four per unit of charge of every body
+     and plate (SEEDING_CHARGE).  With SEEDING_FLUX `line_budget' lines (0 for
+     four per unit of flux, times `line_density') are shared out in
+     proportion to the flux of every body and plate; a body whose flux
+     mostly ends on a close, stronger opposite charge leaves the lines
+     on that side to it. */
+  SeedingType seeding;
+  unsigned int line_budget;
+
+  /* With SEEDING_EVEN the lines from the bodies and plates are ended
+     where they come closer than half this many pixels to another line,
+     and more lines are started in the free space between them, so
+     that lines are about this far apart all over the view (or the
+     scene, without a view).  Divided by sqrt(line_density). */
+  float separation;
+
+  /* Lines between a positive and a negative body are traced from the
+     positive end only: the positive seeds go first, and the seeds of
+     a negative body are skipped where such a line already arrived. */
+  bool skip_arrived;
+
+  /* Finished lines are simplified as long as no point moves farther
+     than this, in pixels; 0 keeps every traced point. */
+  float simplify;
+
+  /* Part of the scene that is shown.  Lines are traced at most
+     `view_margin' beyond it; farther out they are cut off or continued
+     from the far field of the scene.  Without a view (x1 <= x0) they
+     run until the usual step limits. */
+  float view_x0, view_y0, view_x1, view_y1;
+  float view_margin;
+};
+
+/* Deviation of the field used for tracing from the exact force_at(),
+   measured at random points of the scene. */
+struct FieldError
+{
+  unsigned int samples;
+  float max_relative;
+  float mean_relative;
+  float rms_relative;
+  float max_angle;   // in degrees
 };
 
 class Simulation
 {
 public:
-  Vec2 force_at(const Vec2& pos, float charge);
+  Simulation();
+
+  Vec2 force_at(const Vec2& pos, float charge) const;
+  float potential_at(const Vec2& pos) const;
+  Vec2 trace_force(const Vec2& pos, float charge) const;
   void reset(){bodies.clear();plates.clear();result.clear();};
 
+  void set_options(const TraceOptions& opts){options = opts;};
+  const TraceOptions& get_options() const{return options;};
+
   void add_body(const Vec2& v, float charge);
   void add_plate(const Vec2& a, const Vec2& b, float charge);
 
@@ -111,15 +328,146 @@ public:
   Body& operator[](int n){return bodies[n];};
   int n_bodies(){return bodies.size();};
 
+  FieldError field_error(unsigned int samples=10000);
+
+  /* Takes over the bodies, plates and options of `other' and the edit
+     in progress, but not its lines or anything prepared for tracing
+     them; the next run() or stream() prepares that again.  Much less
+     to copy than the whole Simulation, to hand a scene to a thread. */
+  void assign_scene(const Simulation& other);
+
+  /* Traces all lines of the scene into get_result(). */
+  virtual void run();
+
+  /* Traces the same lines as run() without storing them: every line is
+     handed to `done' as soon as it is finished, from whichever thread
+     traced it.  Lines not yet started when `cancel' becomes true are
+     skipped; returns false in that case. */
+  bool stream(const std::atomic<bool>& cancel,
+              const std::function<void(const FluxLine&)>& done);
+
+  const FluxLines& get_result() const{return result;};
+
+  /* Moves a particle of the given charge from each of `starts' along
+     the field, step by step as run() traces its lines, for at most
+     `max_steps' steps each, and returns how many steps were taken in
+     all.  The paths are appended to `l' if given, with the points run()
+     adds between long steps and the step that ended them.  For timing
+     and checking the integrators on their own. */
+  unsigned long follow(const std::vector<Vec2>& starts, float charge,
+                       unsigned int max_steps, FluxLines *l=0);
+
+  /* Samples the potential over the rectangle every `cell' units, in
+     parallel.  equipotentials() then appends the lines at all multiples
+     of `spacing' to `l' from these samples alone, so only this has to
+     be called again when the scene changes. */
+  void sample_potential(float x0, float y0, float x1, float y1, float cell);
+  void equipotentials(float spacing, FluxLines& l);
+
+  /* Exchanges the samples of sample_potential() with `grid', to hand
+     them from one copy of the scene to another. */
+  void swap_potential(PotentialGrid& grid);
+
+  /* Samples the colour map of the field strength or the potential over
+     a width x height image, or again only around the points in `near'
+     after they moved. */
+  void sample_heatmap(FieldMap& map, HeatmapType type, unsigned int width, unsigned int height);
+  void update_heatmap(FieldMap& map, const std::vector<Vec2>& near, float radius);
+
+  /* How many lines of the last run() or stream() stopped for the given
+     reason; a line that leaves the view and comes back counts once,
+     for the way it ended in the end. */
+  unsigned int get_end_count(EndReason reason) const{return end_counts[reason];};
+
+  /* While a single body or plate is edited, the field of all the others
+     is put into a SplitFieldGrid once and the edited one is evaluated
+     on top of it, so that moving it or changing its charge only costs
+     tracing the lines again, not evaluating every source.  The grid is
+     sampled by the first run() or stream() after this, which may be
+     that of a copy on another thread, and is shared by all copies.
+     Lasts until end_edit(), or until bodies or plates are added or
+     removed. */
+  void begin_body_edit(unsigned int n){begin_edit(n, -1);};
+  void begin_plate_edit(unsigned int n){begin_edit(-1, n);};
+  void end_edit(){edit.reset(); others.reset();};
+  bool editing() const{return edit != 0;};
+
 private:
-  bool step(Particle& p, float dtime);
+  void begin_edit(int body, int plate);
+  void prepare_edit();
+  void prepare();
+  void prepare_sources();
+  FieldMap::ValueFunc heatmap_value(HeatmapType type) const;
+  void scene_bounds(float& x0, float& y0, float& x1, float& y1) const;
+  Vec2 direct_force(const Vec2& pos, float charge) const;
+  bool absorbed(const Vec2& from, const Vec2& to, int *body=0) const;
+  Vec2 absorption_point(const Vec2& from, const Vec2& to) const;
+  bool outside_view(const Vec2& pos) const;
+  bool leave_view(Particle& p, const Vec2& from) const;
+  bool step(Particle& p, float dtime) const;
+  void build_seeds(std::vector<Seed>& seeds) const;
+  void charge_seeds(std::vector<Seed>& seeds) const;
+  void flux_seeds(std::vector<Seed>& seeds) const;
+  LineEnd trace(const Seed& seed, FluxLines& l) const;
+  unsigned int order_seeds();
+  void skip_arrived(unsigned int n_first);
+  void count_ends();
+  float crowded(const Vec2& from, const Vec2& to, float dist) const;
+  EndReason trace_spaced(const Vec2& start, float charge, float exempt, float dist, FluxLines& l) const;
+  bool end_spaced(FluxLines& l, float spacing, const std::function<bool(const FluxLine&)>& each);
+  void even_lines(FluxLines& l, const std::function<bool(const FluxLine&)>& each);
 
 protected:
-  virtual void run();
+  TraceOptions options;
 
   std::vector<Body> bodies;
   std::vector<PlateBody> plates;
-  std::vector<FluxLine> result;
+  FluxLines result;
+
+private:
+  BodyArrays body_arrays;
+  std::vector<PlateFrame> plate_frames;
+  QuadTree body_tree;
+  FieldGrid field_cache;
+
+  /* Field of all but the edited object, sampled by whichever copy of
+     the scene is prepared first */
+  struct EditField
+  {
+    std::mutex mutex;
+    std::shared_ptr<const SplitFieldGrid> grid;
+  };
+  std::shared_ptr<EditField> edit;
+  std::shared_ptr<const SplitFieldGrid> others;   // `edit->grid' once prepared
+  int edited_body, edited_plate;             // -1 for none
+  unsigned int edit_bodies, edit_plates;     // scene size the grid was sampled for
+  CaptureGrid capture_grid;
+  OccupancyGrid occupancy;
+  PotentialGrid potential;
+  std::vector<float> levels;
+
+  /* Seen from far away the scene is a point charge plus a dipole at
+     `far_centre'; all sources are within `far_radius' of it. */
+  Vec2 far_centre, far_dipole;
+  float far_charge, far_radius;
+
+  /* Below this the field counts as vanished, for a unit charge */
+  float stagnant_field;
+
+  unsigned int end_counts[END_REASONS_NUM];
+
+  /* Reused between runs: one buffer per tracing thread, and where the
+     lines of every seed ended up. */
+  struct Slot
+  {
+    unsigned int thread, first, count;
+    LineEnd end;
+    bool skip;
+  };
+  std::vector<Seed> seeds;
+  std::vector<FluxLines> arenas;
+  std::vector<Slot> slots;
+  std::vector<LineEnd> arrivals;
 
 };
 
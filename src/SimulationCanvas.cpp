@@ -21,6 +21,7 @@
 #include "Profiling.h"
 
 #include <iostream>
+#include <utility>
 
 #include <gdk/gdkkeysyms.h>
 
@@ -40,15 +41,42 @@ const float SimulationCanvas::MIN_CHARGE(1.0);
 const float SimulationCanvas::CHARGE_STEP(1.0);
 const float SimulationCanvas::CHARGE_STEP_SMALL(0.1);
 
+/* While dragging or changing a charge, a coarse preview is traced at
+   most every PREVIEW_INTERVAL milliseconds; the full scene follows
+   once nothing changed for REFINE_TICKS intervals. */
+const unsigned int SimulationCanvas::PREVIEW_INTERVAL(16);
+const unsigned int SimulationCanvas::REFINE_TICKS(10);
+const float SimulationCanvas::PREVIEW_DENSITY(0.5);
+const unsigned int SimulationCanvas::PREVIEW_STEPS(150);
+
+/* The potential is sampled every this many pixels for the
+   equipotentials. */
+const float SimulationCanvas::POTENTIAL_CELL(4);
+
+/* While dragging, only the colour map within this many pixels of the
+   dragged object is sampled again. */
+const float SimulationCanvas::HEATMAP_RADIUS(160);
+
 SimulationCanvas::SimulationCanvas():
   body_radius(10), plate_radius(5),
-  drag_state(DRAG_STATE_NONE), active(-1), mouse_pressed(false), mouse_over(-1)
+  drag_state(DRAG_STATE_NONE), active(-1), mouse_pressed(false), mouse_over(-1),
+  show_equipotentials(false), level_spacing(0.02), potential_stale(true), levels_stale(true),
+  heatmap_type(HEATMAP_NONE), heatmap_stale(true),
+  lines_stale(false), drag_moved(false), preview_dirty(false),
+  preview_running(false), sampling_only(false), refined(true), idle_ticks(0)
 {
   signal_realize().connect(sigc::mem_fun(*this, &SimulationCanvas::after_realize_event));
+  worker.signal_maps().connect(sigc::mem_fun(*this, &SimulationCanvas::on_maps));
+  worker.signal_lines().connect(sigc::mem_fun(*this, &SimulationCanvas::on_lines));
+  worker.signal_finished().connect(sigc::mem_fun(*this, &SimulationCanvas::on_lines_finished));
 }
 
 SimulationCanvas::~SimulationCanvas()
 {
+#ifdef DEBUG
+  std::cerr << "Result cache: " << cache.hits() << " hits, " << cache.misses() << " misses, "
+            << cache.scenes() << " scenes in " << cache.bytes() << " bytes." << std::endl;
+#endif // DEBUG
 }
 
 void SimulationCanvas::operator=(const Simulation& sim)
@@ -60,21 +88,70 @@ void SimulationCanvas::operator=(const Simulation& sim)
   mouse_pressed = false;
   mouse_over = -1;
   active = -1;
+  end_edit();
 
   sig_selection_changed.emit();
 }
 
+/* Starts tracing the current scene in the background; the lines are
+   drawn as they arrive.  The old lines stay visible until then.  Scenes
+   that were traced before are taken from the cache instead, and the
+   worker only samples the maps for them. */
 void SimulationCanvas::refresh()
 {
-  run();
-  plot();
+  end_edit();
+  potential_stale = true;
+  heatmap_stale = true;
+  moved.clear();
+
+  SimulationWorker::Maps maps;
+  bool sample = full_maps(maps);
+
+  SceneKey key(*this);
+  std::shared_ptr<const FluxLines> lines = cache.find(key);
+  if(lines)
+    {
+      if(sample)
+        worker.sample(*this, maps);
+      else
+        worker.cancel();
+      preview_running = false;
+      sampling_only = sample;
+      lines_stale = false;
+
+      shown.clear();
+      cached = lines;
+      if(gc_white)
+        {
+          draw_flux_lines();
+          plot();
+        }
+      return;
+    }
+
+  traced_key = key;
+
+  worker.start(*this, options, maps);
+  lines_stale = true;
+  preview_running = false;
+  sampling_only = false;
+
+  if(gc_white)
+    plot();
+}
+
+/* Waits for the lines of the last refresh() and draws all of them. */
+void SimulationCanvas::finish()
+{
+  worker.wait();
 }
 
 void SimulationCanvas::clear()
 {
   bodies.clear();
   plates.clear();
-  paths.clear();
+  shown.clear();
+  cached.reset();
 
   mouse_over = active = -1;
   drag_state = DRAG_STATE_NONE;
@@ -89,7 +166,7 @@ bool SimulationCanvas::has_selection()
   if(active < 0)
     return false;
 
-  if(active < 1024)
+  if(active < MAX_BODIES)
   {
     if(static_cast<unsigned int>(active) < bodies.size())
       return true;
@@ -98,7 +175,7 @@ bool SimulationCanvas::has_selection()
   }
   else
   {
-    if(static_cast<unsigned int>(active-1024) < plates.size())
+    if(static_cast<unsigned int>(active-MAX_BODIES) < plates.size())
       return true;
     else
       return false;
@@ -136,9 +213,9 @@ bool SimulationCanvas::delete_plate(unsigned int n)
 
   plates.erase(plates.begin() + n);
 
-  if(static_cast<unsigned int>(active) == (n + 1024))
+  if(static_cast<unsigned int>(active) == (n + MAX_BODIES))
     active = -1;
-  if(static_cast<unsigned int>(mouse_over) == (n + 1024))
+  if(static_cast<unsigned int>(mouse_over) == (n + MAX_BODIES))
     mouse_over = -1;
 
   drag_state = DRAG_STATE_NONE;
@@ -153,13 +230,13 @@ bool SimulationCanvas::delete_selected()
   if(active < 0)
     return false;
 
-  if(active < 1024)
+  if(active < MAX_BODIES)
   {
     r = delete_body(active);
   }
   else
   {
-    r = delete_plate(active - 1024);
+    r = delete_plate(active - MAX_BODIES);
   }
 
   active = -1;
@@ -174,7 +251,7 @@ float SimulationCanvas::get_selected_charge()
   if(active < 0)
     return 0;
 
-  if(active < 1024)
+  if(active < MAX_BODIES)
   {
     n = static_cast<unsigned int>(active);
     if(n < bodies.size())
@@ -184,7 +261,7 @@ float SimulationCanvas::get_selected_charge()
   }
   else
   {
-    n = static_cast<unsigned int>(active-1024);
+    n = static_cast<unsigned int>(active-MAX_BODIES);
     if(n < plates.size())
     {
       return fabs(plates[n].charge);
@@ -204,7 +281,7 @@ bool SimulationCanvas::set_selected_charge(float value)
   if(active < 0)
     return false;
 
-  if(active < 1024)
+  if(active < MAX_BODIES)
   {
     n = static_cast<unsigned int>(active);
     if(n < bodies.size())
@@ -215,7 +292,7 @@ bool SimulationCanvas::set_selected_charge(float value)
   }
   else
   {
-    n = static_cast<unsigned int>(active-1024);
+    n = static_cast<unsigned int>(active-MAX_BODIES);
     if(n < plates.size())
     {
       delta = fabs(fabs(plates[n].charge) - value);
@@ -225,7 +302,12 @@ bool SimulationCanvas::set_selected_charge(float value)
 
   if(delta > 0.01)
   {
-    refresh();
+    if(active < MAX_BODIES)
+      moved.push_back(bodies[n].pos);
+    else
+      note_moved_plate(plates[n]);
+
+    start_drag_timer();
     sig_selected_charge_changed.emit();
   }
 
@@ -268,23 +350,181 @@ sigc::signal<void> SimulationCanvas::signal_selection_changed()
   return sig_selection_changed;
 }
 
-void SimulationCanvas::run()
+/* What the worker samples along with the full scene, false if
+   nothing. */
+bool SimulationCanvas::full_maps(SimulationWorker::Maps& maps)
 {
-  profile_func_start(__PRETTY_FUNCTION__);
+  if(!gc_white)
+    return false;
+
+  maps.width = get_width();
+  maps.height = get_height();
+  maps.potential = show_equipotentials;
+  maps.cell = POTENTIAL_CELL;
+  maps.heatmap = heatmap_type;
+  return maps.potential || maps.heatmap != HEATMAP_NONE;
+}
+
+/* The maps come before the lines of their scene, which draw them; only
+   cached lines have to be drawn again. */
+void SimulationCanvas::on_maps(SimulationWorker::Maps& maps)
+{
+  if(maps.potential)
+    {
+      swap_potential(maps.samples);
+      potential_stale = false;
+      levels_stale = true;
+    }
+
+  /* Only the tiles sampled again are painted, here in the main loop */
+  if(maps.heatmap != HEATMAP_NONE && maps.heatmap == heatmap_type)
+    {
+      std::swap(heatmap, maps.map);
+      heatmap_stale = false;
+
+      unsigned int width = maps.width, height = maps.height;
+      bool resized = heatmap_rgb.size() != width*height*3;
+      if(resized)
+        heatmap_rgb.resize(width*height*3);
+      if(!heatmap_rgb.empty())
+        heatmap.paint(&heatmap_rgb[0], width*3, options.threads, resized);
+    }
+
+  if(!lines_stale && gc_white)
+    {
+      draw_flux_lines();
+      plot();
+    }
+}
 
-  Simulation::run();
+void SimulationCanvas::on_lines(const FluxLines& lines)
+{
+  profile_func_start(__PRETTY_FUNCTION__);
 
-  paths.clear();
-  for(unsigned int i=0; i<result.size(); ++i)
+  if(lines_stale)
     {
-      paths.push_back(result[i]);
+      shown.clear();
+      cached.reset();
+      lines_stale = false;
     }
 
-  draw_flux_lines();
+  unsigned int first = shown.size();
+  shown.append(lines);
+
+  if(gc_white)
+    {
+      draw_flux_lines(first);
+      plot();
+    }
 
   profile_func_end(__PRETTY_FUNCTION__);
 }
 
+void SimulationCanvas::on_lines_finished()
+{
+  /* A scene without any lines */
+  if(lines_stale)
+    {
+      shown.clear();
+      cached.reset();
+      lines_stale = false;
+
+      if(gc_white)
+        {
+          draw_flux_lines();
+          plot();
+        }
+    }
+
+  /* All lines of a full trace are shown by now.  They move into the
+     cache and are drawn from there. */
+  if(!preview_running && !sampling_only)
+    {
+      std::shared_ptr<FluxLines> lines = std::make_shared<FluxLines>();
+      lines->swap(shown);
+      cache.insert(traced_key, lines);
+      cached = lines;
+    }
+  preview_running = false;
+  sampling_only = false;
+}
+
+void SimulationCanvas::start_drag_timer()
+{
+  drag_moved = true;
+  if(!drag_timer.connected())
+    {
+      drag_timer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &SimulationCanvas::on_drag_timeout),
+                                                  PREVIEW_INTERVAL);
+    }
+}
+
+/* Motion events are only recorded and handled here, so a preview is
+   started at most once per tick and never while the last one is still
+   being traced. */
+bool SimulationCanvas::on_drag_timeout()
+{
+  /* A charge change is over once the full scene was started. */
+  if(drag_state == DRAG_STATE_NONE && refined && !drag_moved)
+    return false;
+
+  if(drag_moved)
+    {
+      drag_moved = false;
+      preview_dirty = true;
+      refined = false;
+      idle_ticks = 0;
+    }
+  else if(!refined && ++idle_ticks >= REFINE_TICKS)
+    {
+      refined = true;
+      preview_dirty = false;
+      refresh();
+    }
+
+  if(preview_dirty && !(worker.busy() && preview_running))
+    start_preview();
+
+  return true;
+}
+
+/* Traces fewer lines with a looser tolerance and a step budget, in the
+   field of the edited object on top of that of all others. */
+void SimulationCanvas::start_preview()
+{
+  edit_active();
+
+  TraceOptions opts = options;
+  opts.integrator = INTEGRATOR_RK45;
+  opts.tolerance = options.tolerance*10;
+  opts.line_density = PREVIEW_DENSITY;
+  opts.max_steps = PREVIEW_STEPS;
+
+  /* The colour map is lent to the worker, which samples it again only
+     around the dragged objects, or in full if the scene changed
+     otherwise since one came back. */
+  SimulationWorker::Maps maps;
+  if(heatmap_type != HEATMAP_NONE && gc_white)
+    {
+      maps.width = get_width();
+      maps.height = get_height();
+      maps.heatmap = heatmap_type;
+      if(!heatmap_stale)
+        {
+          std::swap(maps.map, heatmap);
+          maps.near.swap(moved);
+          maps.radius = HEATMAP_RADIUS;
+        }
+    }
+  moved.clear();
+
+  worker.start(*this, opts, maps);
+  lines_stale = true;
+  preview_dirty = false;
+  preview_running = true;
+  sampling_only = false;
+}
+
 void SimulationCanvas::plot()
 {
   Glib::RefPtr<Gdk::Drawable> pixmap = get_pixmap();
@@ -297,21 +537,143 @@ void SimulationCanvas::plot()
   get_window()->invalidate_rect(Gdk::Rectangle(0, 0, get_width(), get_height()), false);
 }
 
-void SimulationCanvas::draw_flux_lines()
+/* Draws the lines from `first' on; the pixmap is cleared when drawing
+   starts with the first one.  The points are rounded to pixels here,
+   straight from the traced lines. */
+void SimulationCanvas::draw_flux_lines(unsigned int first)
 {
   profile_func_start(__PRETTY_FUNCTION__);
 
-  lines_pixmap->draw_rectangle(gc_white, true, 0, 0, get_width(), get_height());
+  if(first == 0)
+    {
+      if(heatmap_type != HEATMAP_NONE)
+        draw_heatmap();
+      else
+        lines_pixmap->draw_rectangle(gc_white, true, 0, 0, get_width(), get_height());
+      if(show_equipotentials)
+        draw_equipotentials();
+    }
 
-  for(unsigned int i=0; i<paths.size(); i++)
+  const FluxLines& lines = drawn();
+  for(unsigned int i=first; i<lines.size(); i++)
     {
-      const std::vector<Gdk::Point>& points = paths[i].get_points();
+      FluxLine l = lines[i];
+      points.resize(l.size);
+      for(unsigned int j=0; j<l.size; ++j)
+        points[j] = Gdk::Point(static_cast<int>(l[j].get_x()),
+                               static_cast<int>(l[j].get_y()));
       lines_pixmap->draw_lines(gc_black, points);
     }
 
   profile_func_end(__PRETTY_FUNCTION__);
 }
 
+/* The potential is sampled by the worker with the full scene, see
+   on_maps(); previews keep the lines of the last one.  A new spacing
+   just walks the old samples. */
+void SimulationCanvas::draw_equipotentials()
+{
+  profile_func_start(__PRETTY_FUNCTION__);
+
+  if(levels_stale)
+    {
+      equipotentials.clear();
+      Simulation::equipotentials(level_spacing, equipotentials);
+      levels_stale = false;
+    }
+
+  for(unsigned int i=0; i<equipotentials.size(); i++)
+    {
+      FluxLine l = equipotentials[i];
+      points.resize(l.size);
+      for(unsigned int j=0; j<l.size; ++j)
+        points[j] = Gdk::Point(static_cast<int>(l[j].get_x()),
+                               static_cast<int>(l[j].get_y()));
+      lines_pixmap->draw_lines(gc_equipotential, points);
+    }
+
+  profile_func_end(__PRETTY_FUNCTION__);
+}
+
+/* Only the selected object changes until the next refresh(), so the
+   field of all others is kept, see Simulation::begin_body_edit().  The
+   worker samples it with the first preview; nothing is computed here. */
+void SimulationCanvas::edit_active()
+{
+  if(editing() || active < 0)
+    return;
+
+  if(active < MAX_BODIES)
+    begin_body_edit(active);
+  else
+    begin_plate_edit(active - MAX_BODIES);
+}
+
+/* Draws the colour map painted by on_maps(); the worker samples it
+   with every scene, see start_preview().  The background stays white
+   until a map of the window's size is back. */
+void SimulationCanvas::draw_heatmap()
+{
+  unsigned int width = get_width(), height = get_height();
+  if(!heatmap_rgb.empty() && heatmap_rgb.size() == width*height*3)
+    lines_pixmap->draw_rgb_image(gc, 0, 0, width, height, Gdk::RGB_DITHER_NONE,
+                                 &heatmap_rgb[0], width*3);
+  else
+    lines_pixmap->draw_rectangle(gc_white, true, 0, 0, width, height);
+}
+
+void SimulationCanvas::note_moved_plate(const PlateBody& plate)
+{
+  moved.push_back(plate.pos_a);
+  moved.push_back((plate.pos_a + plate.pos_b)*0.5);
+  moved.push_back(plate.pos_b);
+}
+
+void SimulationCanvas::set_heatmap(HeatmapType type)
+{
+  if(type == heatmap_type)
+    return;
+
+  heatmap_type = type;
+  heatmap_rgb.clear();
+  if(type != HEATMAP_NONE)
+    refresh();
+  else if(gc_white)
+    {
+      draw_flux_lines();
+      plot();
+    }
+}
+
+void SimulationCanvas::set_equipotentials(bool show)
+{
+  if(show == show_equipotentials)
+    return;
+
+  show_equipotentials = show;
+  if(show && potential_stale)
+    refresh();
+  else if(gc_white)
+    {
+      draw_flux_lines();
+      plot();
+    }
+}
+
+void SimulationCanvas::set_equipotential_spacing(float spacing)
+{
+  if(spacing == level_spacing)
+    return;
+
+  level_spacing = spacing;
+  levels_stale = true;
+  if(gc_white && show_equipotentials)
+    {
+      draw_flux_lines();
+      plot();
+    }
+}
+
 inline void SimulationCanvas::draw_body(int n)
 {
   const Body& body = bodies[n];
@@ -369,7 +731,7 @@ void SimulationCanvas::draw_bodies(bool draw_selected)
           draw_body(i);
         }
     }
-  if((active >= 0 && active < 1024) && draw_selected)
+  if((active >= 0 && active < MAX_BODIES) && draw_selected)
     {
       const Body& body = bodies[active];
       draw_body(active);
@@ -396,7 +758,7 @@ inline void SimulationCanvas::draw_plate(int n)
     offset = 3;
 
   Gdk::Color color;
-  if(mouse_over == (n+1024))
+  if(mouse_over == (n+MAX_BODIES))
     color = colors[offset + BODY_STATE_HIGHLIGHT];
   else
     color = colors[offset + BODY_STATE_NORMAL];
@@ -440,7 +802,7 @@ void SimulationCanvas::draw_plates(bool draw_selected)
 {
   for(unsigned int i=0; i<plates.size(); i++)
     {
-      if(static_cast<unsigned int>(active) == (i+1024))
+      if(static_cast<unsigned int>(active) == (i+MAX_BODIES))
         {
         }
       else
@@ -449,10 +811,10 @@ void SimulationCanvas::draw_plates(bool draw_selected)
         }
     }
 
-  if(active >= 1024 && draw_selected)
+  if(active >= MAX_BODIES && draw_selected)
     {
-      const PlateBody& plate = plates[active-1024];
-      draw_plate(active-1024);
+      const PlateBody& plate = plates[active-MAX_BODIES];
+      draw_plate(active-MAX_BODIES);
       Gdk::Rectangle rect;
 
       pixmap->draw_arc(gc_selection, true,
@@ -504,6 +866,10 @@ void SimulationCanvas::after_realize_event()
   gc_selection->set_line_attributes(4, Gdk::LINE_SOLID,
                                     Gdk::CAP_ROUND, Gdk::JOIN_ROUND);
 
+  gc_equipotential = Gdk::GC::create(get_pixmap());
+  gc_equipotential->set_rgb_fg_color(Gdk::Color("#999999"));
+  gc_equipotential->set_rgb_bg_color(Gdk::Color("white"));
+
   gc_platebody = Gdk::GC::create(get_pixmap());
   gc_platebody->set_rgb_bg_color(Gdk::Color("white"));
   gc_platebody->set_line_attributes(4, Gdk::LINE_SOLID,
@@ -534,6 +900,16 @@ bool SimulationCanvas::on_configure_event(GdkEventConfigure *event)
       draw_flux_lines();
       plot();
     }
+
+  /* Lines are only traced a little beyond the window, so they have to
+     be traced again once it gets larger. */
+  if(options.view_x1 != get_width() || options.view_y1 != get_height())
+    {
+      options.view_x0 = options.view_y0 = 0;
+      options.view_x1 = get_width();
+      options.view_y1 = get_height();
+      refresh();
+    }
   return false;
 }
 
@@ -549,7 +925,9 @@ bool SimulationCanvas::on_motion_notify_event(GdkEventMotion *event)
       x = static_cast<int>(bodies[active].pos.get_x()) - 2*body_radius;
       y = static_cast<int>(bodies[active].pos.get_y()) - 2*body_radius;
       
+      moved.push_back(bodies[active].pos);
       bodies[active].pos = Vec2(event->x+drag_offset.get_x(), event->y+drag_offset.get_y());
+      moved.push_back(bodies[active].pos);
 
       pixmap->draw_drawable(gc, lines_pixmap, x-5, y-5, x-5, y-5,
                             4*body_radius+10, 4*body_radius+10);
@@ -558,6 +936,8 @@ bool SimulationCanvas::on_motion_notify_event(GdkEventMotion *event)
       
       draw_plates();
       draw_bodies();
+
+      start_drag_timer();
       break;
     }
   case DRAG_STATE_PLATE:
@@ -565,7 +945,7 @@ bool SimulationCanvas::on_motion_notify_event(GdkEventMotion *event)
   case DRAG_STATE_PLATE_B:
     {
       Gdk::Rectangle rect;
-      PlateBody& plate = plates[active-1024];
+      PlateBody& plate = plates[active-MAX_BODIES];
 
       if(plate.pos_a.get_x() < plate.pos_b.get_x())
       {
@@ -589,6 +969,7 @@ bool SimulationCanvas::on_motion_notify_event(GdkEventMotion *event)
         rect.set_height(static_cast<int>(plate.pos_a.get_y()) - static_cast<int>(plate.pos_b.get_y()) + 2*plate_radius);
       }
 
+      note_moved_plate(plate);
       if(drag_state == DRAG_STATE_PLATE_A)
       {
         plate.pos_a = Vec2(event->x+drag_offset.get_x(), event->y+drag_offset.get_y());
@@ -604,6 +985,7 @@ bool SimulationCanvas::on_motion_notify_event(GdkEventMotion *event)
         plate.pos_a = Vec2(event->x+drag_offset.get_x(), event->y+drag_offset.get_y());
         plate.pos_b = Vec2(event->x+drag_offset.get_x()+sx, event->y+drag_offset.get_y()+sy);
       }
+      note_moved_plate(plate);
 
       pixmap->draw_drawable(gc, lines_pixmap, rect.get_x(), rect.get_y(), rect.get_x(), rect.get_y(),
                             rect.get_width(), rect.get_height());
@@ -612,6 +994,7 @@ bool SimulationCanvas::on_motion_notify_event(GdkEventMotion *event)
       draw_plates();
       draw_bodies();
 
+      start_drag_timer();
       break;
     }
   default:
@@ -635,18 +1018,18 @@ bool SimulationCanvas::on_motion_notify_event(GdkEventMotion *event)
               int n = object_at(last_click.get_x(), last_click.get_y());
               if(n >= 0)
               {
-                if(n < 1024)
+                if(n < MAX_BODIES)
                 {
                   drag_state = DRAG_STATE_BODY;
                 }
                 else
                 {
                   drag_state = DRAG_STATE_PLATE;
-                  if(point_hits_plate_a(plates[n-1024], last_click.get_x(), last_click.get_y()))
+                  if(point_hits_plate_a(plates[n-MAX_BODIES], last_click.get_x(), last_click.get_y()))
                   {
                     drag_state = DRAG_STATE_PLATE_A;
                   }
-                  else if(point_hits_plate_b(plates[n-1024], last_click.get_x(), last_click.get_y()))
+                  else if(point_hits_plate_b(plates[n-MAX_BODIES], last_click.get_x(), last_click.get_y()))
                   {
                     drag_state = DRAG_STATE_PLATE_B;
                   }
@@ -672,27 +1055,27 @@ bool SimulationCanvas::on_button_press_event(GdkEventButton *event)
 
     if(mouse_over >= 0)
     {
-      if(mouse_over < 1024)
+      if(mouse_over < MAX_BODIES)
       {
         drag_offset = Gdk::Point(static_cast<int>(bodies[mouse_over].pos.get_x()-event->x),
                                  static_cast<int>(bodies[mouse_over].pos.get_y()-event->y));
       }
       else
       {
-        if(point_hits_plate_b(plates[mouse_over-1024], static_cast<int>(event->x), static_cast<int>(event->y)))
+        if(point_hits_plate_b(plates[mouse_over-MAX_BODIES], static_cast<int>(event->x), static_cast<int>(event->y)))
         {
-          drag_offset = Gdk::Point(static_cast<int>(plates[mouse_over-1024].pos_b.get_x()-event->x),
-                                   static_cast<int>(plates[mouse_over-1024].pos_b.get_y()-event->y));
+          drag_offset = Gdk::Point(static_cast<int>(plates[mouse_over-MAX_BODIES].pos_b.get_x()-event->x),
+                                   static_cast<int>(plates[mouse_over-MAX_BODIES].pos_b.get_y()-event->y));
         }
         else
         {
-          drag_offset = Gdk::Point(static_cast<int>(plates[mouse_over-1024].pos_a.get_x()-event->x),
-                                   static_cast<int>(plates[mouse_over-1024].pos_a.get_y()-event->y));
+          drag_offset = Gdk::Point(static_cast<int>(plates[mouse_over-MAX_BODIES].pos_a.get_x()-event->x),
+                                   static_cast<int>(plates[mouse_over-MAX_BODIES].pos_a.get_y()-event->y));
         }
       }
     }
 
-    if((active >= 0) && (active < 1024))
+    if((active >= 0) && (active < MAX_BODIES))
     {
       int x, y;
       x = static_cast<int>(bodies[active].pos.get_x()) - 2*body_radius;
@@ -702,17 +1085,17 @@ bool SimulationCanvas::on_button_press_event(GdkEventButton *event)
                             4*body_radius+10, 4*body_radius+10);
     }
 
-    if(active >= 1024)
+    if(active >= MAX_BODIES)
     {
       int x, y;
-      x = static_cast<int>(plates[active-1024].pos_a.get_x()) - plate_radius;
-      y = static_cast<int>(plates[active-1024].pos_a.get_y()) - plate_radius;
+      x = static_cast<int>(plates[active-MAX_BODIES].pos_a.get_x()) - plate_radius;
+      y = static_cast<int>(plates[active-MAX_BODIES].pos_a.get_y()) - plate_radius;
 
       pixmap->draw_drawable(gc, lines_pixmap, x-2, y-2, x-2, y-2,
                             2*plate_radius+4, 2*plate_radius+4);
 
-      x = static_cast<int>(plates[active-1024].pos_b.get_x()) - plate_radius;
-      y = static_cast<int>(plates[active-1024].pos_b.get_y()) - plate_radius;
+      x = static_cast<int>(plates[active-MAX_BODIES].pos_b.get_x()) - plate_radius;
+      y = static_cast<int>(plates[active-MAX_BODIES].pos_b.get_y()) - plate_radius;
 
       pixmap->draw_drawable(gc, lines_pixmap, x-2, y-2, x-2, y-2,
                             2*plate_radius+4, 2*plate_radius+4);
@@ -720,6 +1103,7 @@ bool SimulationCanvas::on_button_press_event(GdkEventButton *event)
 
     if(active != mouse_over)
     {
+      end_edit();
       active = mouse_over;
       sig_selection_changed.emit();
     }
@@ -751,6 +1135,7 @@ bool SimulationCanvas::on_button_release_event(GdkEventButton *event)
         }
       }
       drag_state = DRAG_STATE_NONE;
+      drag_timer.disconnect();
       refresh();
     }
     else
@@ -868,7 +1253,7 @@ int SimulationCanvas::object_at(int x, int y)
   {
     if(point_hits_plate(plates[i], x, y))
     {
-      return (i + 1024);
+      return (i + MAX_BODIES);
     }
   }
 
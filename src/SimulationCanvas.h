@@ -22,8 +22,11 @@
 #define _SIMULATIONCANVAS_H_
 
 #include <vector>
+#include <memory>
 
 #include "Simulation.h"
+#include "SimulationWorker.h"
+#include "ResultCache.h"
 #include "Canvas.h"
 
 namespace Elfelli
@@ -63,6 +66,7 @@ public:
   bool has_selection();
 
   void refresh();
+  void finish();
   void clear();
   bool delete_body(unsigned int n);
   bool delete_plate(unsigned int n);
@@ -78,13 +82,44 @@ public:
   sigc::signal<void> signal_selected_charge_changed();
   sigc::signal<void> signal_selection_changed();
 
+  const ResultCache& get_cache() const{return cache;};
+
+  /* Equipotential lines under the field lines, at all multiples of the
+     spacing.  Changing the spacing reuses the sampled potential. */
+  void set_equipotentials(bool show);
+  void set_equipotential_spacing(float spacing);
+
+  /* Colour map behind the lines */
+  void set_heatmap(HeatmapType type);
+
   static const float MAX_CHARGE;
   static const float MIN_CHARGE;
   static const float CHARGE_STEP;
   static const float CHARGE_STEP_SMALL;
 
+  static const unsigned int PREVIEW_INTERVAL;
+  static const unsigned int REFINE_TICKS;
+  static const float PREVIEW_DENSITY;
+  static const unsigned int PREVIEW_STEPS;
+  static const float POTENTIAL_CELL;
+  static const float HEATMAP_RADIUS;
+
 private:
-  void draw_flux_lines();
+  bool full_maps(SimulationWorker::Maps& maps);
+  void on_maps(SimulationWorker::Maps& maps);
+  void on_lines(const FluxLines& lines);
+  void on_lines_finished();
+
+  void start_drag_timer();
+  bool on_drag_timeout();
+  void start_preview();
+  void edit_active();
+
+  const FluxLines& drawn() const{return cached ? *cached : shown;};
+  void draw_flux_lines(unsigned int first=0);
+  void draw_equipotentials();
+  void draw_heatmap();
+  void note_moved_plate(const PlateBody& plate);
   void draw_bodies(bool draw_selected=true);
   inline void draw_body(int n);
   void draw_plates(bool draw_selected=true);
@@ -107,16 +142,43 @@ private:
   int mouse_over;
   Gdk::Point last_click, drag_offset;
 
-  Glib::RefPtr<Gdk::GC> gc, gc_black, gc_white, gc_selection, gc_platebody;
+  Glib::RefPtr<Gdk::GC> gc, gc_black, gc_white, gc_selection, gc_platebody, gc_equipotential;
   Gdk::Color colors[BODY_STATES_NUM * 2];
   Glib::RefPtr<Gdk::Pixmap> lines_pixmap;
-  std::vector<Path> paths;
+  FluxLines shown;                 // the lines on `lines_pixmap' as they arrive,
+  std::shared_ptr<const FluxLines> cached;  // or these, shared with `cache'
+  std::vector<Gdk::Point> points;  // scratch buffer of draw_flux_lines()
+
+  bool show_equipotentials;
+  float level_spacing;
+  FluxLines equipotentials;
+  bool potential_stale;   // the potential was not sampled since the last refresh()
+  bool levels_stale;      // `equipotentials' do not match the samples or spacing
+
+  HeatmapType heatmap_type;
+  FieldMap heatmap;         // lent to the worker while it samples a preview
+  std::vector<guint8> heatmap_rgb;
+  bool heatmap_stale;       // no map came back since the last refresh()
+  std::vector<Vec2> moved;  // where objects were dragged from and to
+
+  SimulationWorker worker;
+  bool lines_stale;   // `shown' belongs to the scene before the last refresh()
+
+  ResultCache cache;
+  SceneKey traced_key;             // scene the worker is tracing in full
+
+  sigc::connection drag_timer;
+  bool drag_moved;       // the pointer moved since the last timer tick
+  bool preview_dirty;    // the scene changed since the last preview
+  bool preview_running;  // the worker is tracing a preview, not the full scene
+  bool sampling_only;    // the worker only samples the maps of cached lines
+  bool refined;          // the full scene was started since the last move
+  unsigned int idle_ticks;
 
   sigc::signal<void> sig_selected_charge_changed;
   sigc::signal<void> sig_selection_changed;
 
 protected:
-  virtual void run();
   void plot();
 
   virtual void after_realize_event();
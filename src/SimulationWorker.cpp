@@ -0,0 +1,247 @@
+/*
+ * SimulationWorker.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "SimulationWorker.h"
+
+#include <utility>
+
+namespace Elfelli
+{
+
+SimulationWorker::SimulationWorker():
+  have_pending(false), pending_trace(false), pending_sample(false), quit(false), done(false),
+  generation(0), maps_ready(false), cancelled(false), running(false)
+{
+  dispatcher.connect(sigc::mem_fun(*this, &SimulationWorker::on_dispatch));
+  thread = std::thread(&SimulationWorker::thread_main, this);
+}
+
+SimulationWorker::~SimulationWorker()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+    cancelled = true;
+  }
+  cond.notify_all();
+  thread.join();
+}
+
+void SimulationWorker::start(const Simulation& scene)
+{
+  start(scene, scene.get_options());
+}
+
+/* Traces `scene' with `opts' instead of its own options. */
+void SimulationWorker::start(const Simulation& scene, const TraceOptions& opts)
+{
+  start(scene, opts, 0, true);
+}
+
+/* Also samples `maps' first, which are taken over. */
+void SimulationWorker::start(const Simulation& scene, const TraceOptions& opts, Maps& maps)
+{
+  start(scene, opts, &maps, true);
+}
+
+/* Only samples `maps', for lines that are known already. */
+void SimulationWorker::sample(const Simulation& scene, Maps& maps)
+{
+  start(scene, scene.get_options(), &maps, false);
+}
+
+void SimulationWorker::start(const Simulation& scene, const TraceOptions& opts, Maps *maps, bool trace)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    generation++;
+    pending.assign_scene(scene);
+    pending.set_options(opts);
+    pending_trace = trace;
+    pending_sample = (maps != 0);
+    if(maps)
+      std::swap(pending_maps, *maps);
+    have_pending = true;
+    done = false;
+    queue.clear();
+    maps_ready = false;
+    cancelled = true;
+  }
+  cond.notify_all();
+  running = true;
+}
+
+void SimulationWorker::cancel()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    generation++;
+    have_pending = false;
+    done = false;
+    queue.clear();
+    maps_ready = false;
+    cancelled = true;
+  }
+  running = false;
+}
+
+void SimulationWorker::wait()
+{
+  if(!running)
+    return;
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [this]{return done || quit;});
+  }
+  on_dispatch();
+}
+
+sigc::signal<void, SimulationWorker::Maps&> SimulationWorker::signal_maps()
+{
+  return sig_maps;
+}
+
+sigc::signal<void, const FluxLines&> SimulationWorker::signal_lines()
+{
+  return sig_lines;
+}
+
+sigc::signal<void> SimulationWorker::signal_finished()
+{
+  return sig_finished;
+}
+
+void SimulationWorker::thread_main()
+{
+  Simulation sim;
+  Maps maps;
+
+  for(;;)
+  {
+    unsigned int gen;
+    bool trace, sample;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [this]{return quit || have_pending;});
+      if(quit)
+        return;
+
+      sim.assign_scene(pending);
+      trace = pending_trace;
+      sample = pending_sample;
+      if(sample)
+        std::swap(maps, pending_maps);
+      gen = generation;
+      have_pending = false;
+      cancelled = false;
+    }
+
+    if(sample && !cancelled)
+    {
+      if(maps.potential)
+      {
+        sim.sample_potential(0, 0, maps.width, maps.height, maps.cell);
+        sim.swap_potential(maps.samples);
+      }
+
+      if(maps.heatmap != HEATMAP_NONE)
+      {
+        if(maps.map.empty() || maps.map.get_type() != maps.heatmap)
+          sim.sample_heatmap(maps.map, maps.heatmap, maps.width, maps.height);
+        else
+          sim.update_heatmap(maps.map, maps.near, maps.radius);
+      }
+
+      bool wake;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        wake = (gen == generation);
+        if(wake)
+        {
+          std::swap(ready_maps, maps);
+          maps_ready = true;
+        }
+      }
+      if(wake)
+        dispatcher.emit();
+    }
+
+    /* Only the first line of an empty queue needs to wake up the main
+       loop, it takes everything queued up to then at once. */
+    if(trace)
+      sim.stream(cancelled,
+                 [&](const FluxLine& l)
+                 {
+                   bool wake;
+                   {
+                     std::lock_guard<std::mutex> lock(mutex);
+                     if(gen != generation)
+                       return;
+                     wake = queue.empty();
+                     queue.append(l);
+                   }
+                   if(wake)
+                     dispatcher.emit();
+                 });
+
+    bool finished;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      finished = (gen == generation);
+      if(finished)
+        done = true;
+    }
+    if(finished)
+    {
+      cond.notify_all();
+      dispatcher.emit();
+    }
+  }
+}
+
+void SimulationWorker::on_dispatch()
+{
+  bool finished, maps;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    batch.swap(queue);
+    queue.clear();
+    maps = maps_ready;
+    if(maps)
+      std::swap(maps_batch, ready_maps);
+    maps_ready = false;
+    finished = done;
+    done = false;
+  }
+
+  if(maps)
+    sig_maps.emit(maps_batch);
+
+  if(!batch.empty())
+    sig_lines.emit(batch);
+
+  if(finished)
+  {
+    running = false;
+    sig_finished.emit();
+  }
+}
+
+}
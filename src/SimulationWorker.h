@@ -0,0 +1,120 @@
+// -*- C++ -*-
+/*
+ * SimulationWorker.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _SIMULATIONWORKER_H_
+#define _SIMULATIONWORKER_H_
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include <glibmm/dispatcher.h>
+#include <sigc++/sigc++.h>
+
+#include "Simulation.h"
+
+namespace Elfelli
+{
+
+/* Traces a copy of a scene on a background thread and passes the
+   finished flux lines to the main loop in batches.  Starting a new
+   scene cancels the one in progress; lines that still arrive from a
+   cancelled scene are dropped. */
+class SimulationWorker
+{
+public:
+  SimulationWorker();
+  ~SimulationWorker();
+
+  /* Sampled on the thread before the lines of a scene and passed back
+     with signal_maps(), so the main loop never waits for them. */
+  struct Maps
+  {
+    Maps(): potential(false), width(0), height(0), cell(0),
+            heatmap(HEATMAP_NONE), radius(0){};
+
+    bool potential;                // sample the potential every `cell'
+    unsigned int width, height;    // over this rectangle from the origin
+    float cell;
+    PotentialGrid samples;         // the potential, on return
+
+    HeatmapType heatmap;           // sample the colour map unless none:
+    FieldMap map;                  // all of it if `map' is empty or of
+    std::vector<Vec2> near;        // another type, else only within
+    float radius;                  // `radius' of the points in `near'
+  };
+
+  void start(const Simulation& scene);
+  void start(const Simulation& scene, const TraceOptions& opts);
+  void start(const Simulation& scene, const TraceOptions& opts, Maps& maps);
+  void sample(const Simulation& scene, Maps& maps);
+  void cancel();
+
+  /* Blocks until the current scene is finished and delivers all of its
+     lines before returning. */
+  void wait();
+
+  bool busy() const{return running;};
+
+  /* All are emitted in the main loop.  `maps' comes before the first
+     line, and the samples may be swapped out of it; `lines' gets every
+     line exactly once, `finished' is emitted after the last line of a
+     scene. */
+  sigc::signal<void, Maps&> signal_maps();
+  sigc::signal<void, const FluxLines&> signal_lines();
+  sigc::signal<void> signal_finished();
+
+private:
+  void start(const Simulation& scene, const TraceOptions& opts, Maps *maps, bool trace);
+  void thread_main();
+  void on_dispatch();
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cond;
+
+  /* Guarded by `mutex'.  Only the scene of `pending' is set, see
+     Simulation::assign_scene(); the thread keeps its own Simulation
+     with the buffers of the last run. */
+  Simulation pending;
+  Maps pending_maps;
+  bool have_pending, pending_trace, pending_sample, quit, done;
+  unsigned int generation;
+  FluxLines queue;
+  FluxLines batch;   // main thread only, swapped with `queue'
+  Maps ready_maps;
+  Maps maps_batch;   // main thread only, swapped with `ready_maps'
+  bool maps_ready;
+
+  std::atomic<bool> cancelled;
+  bool running;   // main thread only
+
+  Glib::Dispatcher dispatcher;
+
+  sigc::signal<void, Maps&> sig_maps;
+  sigc::signal<void, const FluxLines&> sig_lines;
+  sigc::signal<void> sig_finished;
+};
+
+}
+
+#endif // _SIMULATIONWORKER_H_
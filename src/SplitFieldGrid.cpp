@@ -0,0 +1,213 @@
+/*
+ * SplitFieldGrid.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "SplitFieldGrid.h"
+#include "Parallel.h"
+#include <math.h>
+
+namespace Elfelli
+{
+
+const float SplitFieldGrid::TILE_SIZE(32);
+
+/* Distance from (px, py) to the plate. */
+static float plate_distance(const PlateFrame& p, float px, float py)
+{
+  float u = (px - p.ax)*p.dx + (py - p.ay)*p.dy;
+  u = fmax(0.0f, fmin(p.length, u));
+
+  float ex = p.ax + u*p.dx - px, ey = p.ay + u*p.dy - py;
+  return sqrt(ex*ex + ey*ey);
+}
+
+SplitFieldGrid::SplitFieldGrid():
+  x0(0), y0(0), nx(0), ny(0)
+{
+}
+
+void SplitFieldGrid::clear()
+{
+  tiles.clear();
+  samples.clear();
+  near_bodies.clear();
+  near_plates.clear();
+  nx = ny = 0;
+}
+
+void SplitFieldGrid::build(float left, float top, float right, float bottom,
+                           const BodyArrays& bodies, const std::vector<PlateFrame>& plates,
+                           float near_radius, unsigned int threads)
+{
+  clear();
+
+  x0 = left;
+  y0 = top;
+  nx = static_cast<unsigned int>(ceil((right - left)/TILE_SIZE));
+  ny = static_cast<unsigned int>(ceil((bottom - top)/TILE_SIZE));
+  if(nx == 0 || ny == 0)
+    return;
+
+  tiles.resize(nx*ny);
+
+  /* A source is near a tile if it is closer than the near radius to
+     any point of it; the resolution of the rest depends on how far
+     the closest of the other sources is, as in FieldGrid. */
+  const float half_diagonal = TILE_SIZE*0.7072;
+  std::vector<float> body_dist(bodies.size()), plate_dist(plates.size());
+  unsigned int offset = 0;
+  for(unsigned int t=0; t<tiles.size(); ++t)
+  {
+    float cx = x0 + (t % nx + 0.5)*TILE_SIZE;
+    float cy = y0 + (t / nx + 0.5)*TILE_SIZE;
+    Tile& tile = tiles[t];
+
+    float far = 1e30;
+    tile.first_body = near_bodies.size()/3;
+    for(unsigned int i=0; i<bodies.size(); ++i)
+    {
+      float dx = bodies.x[i] - cx, dy = bodies.y[i] - cy;
+      float dist = sqrt(dx*dx + dy*dy) - half_diagonal;
+      if(dist < near_radius)
+      {
+        near_bodies.push_back(bodies.x[i]);
+        near_bodies.push_back(bodies.y[i]);
+        near_bodies.push_back(bodies.charge[i]);
+      }
+      else
+        far = fmin(far, dist);
+    }
+    tile.n_bodies = near_bodies.size()/3 - tile.first_body;
+
+    tile.first_plate = near_plates.size();
+    for(unsigned int i=0; i<plates.size(); ++i)
+    {
+      float dist = plate_distance(plates[i], cx, cy) - half_diagonal;
+      if(dist < near_radius)
+        near_plates.push_back(plates[i]);
+      else
+        far = fmin(far, dist);
+    }
+    tile.n_plates = near_plates.size() - tile.first_plate;
+
+    if(far > 1e29)
+      tile.res = 1;
+    else if(far < 2*TILE_SIZE)
+      tile.res = 16;
+    else if(far < 6*TILE_SIZE)
+      tile.res = 8;
+    else
+      tile.res = 4;
+
+    tile.offset = offset;
+    offset += 2*(tile.res + 1)*(tile.res + 1);
+  }
+
+  samples.resize(offset);
+
+  parallel_for(tiles.size(), threads,
+               [&](unsigned int t)
+               {
+                 const Tile& tile = tiles[t];
+                 float tx0 = x0 + (t % nx)*TILE_SIZE;
+                 float ty0 = y0 + (t / nx)*TILE_SIZE;
+                 float cx = tx0 + 0.5*TILE_SIZE, cy = ty0 + 0.5*TILE_SIZE;
+
+                 /* The same test as above picks the other sources. */
+                 BodyArrays far_bodies;
+                 std::vector<PlateFrame> far_plates;
+                 for(unsigned int i=0; i<bodies.size(); ++i)
+                 {
+                   float dx = bodies.x[i] - cx, dy = bodies.y[i] - cy;
+                   if(sqrt(dx*dx + dy*dy) - half_diagonal >= near_radius)
+                     far_bodies.add(bodies.x[i], bodies.y[i], bodies.charge[i]);
+                 }
+                 for(unsigned int i=0; i<plates.size(); ++i)
+                   if(plate_distance(plates[i], cx, cy) - half_diagonal >= near_radius)
+                     far_plates.push_back(plates[i]);
+
+                 float spacing = TILE_SIZE/tile.res;
+                 float *out = &samples[tile.offset];
+                 for(unsigned int j=0; j<=tile.res; ++j)
+                   for(unsigned int i=0; i<=tile.res; ++i)
+                   {
+                     float px = tx0 + i*spacing, py = ty0 + j*spacing;
+                     float fx, fy;
+                     body_field(far_bodies, px, py, fx, fy);
+                     for(unsigned int k=0; k<far_plates.size(); ++k)
+                       plate_field_fast(far_plates[k], px, py, fx, fy);
+                     *out++ = fx;
+                     *out++ = fy;
+                   }
+               });
+}
+
+bool SplitFieldGrid::sample(float x, float y, float& fx, float& fy) const
+{
+  float gx = (x - x0)/TILE_SIZE;
+  float gy = (y - y0)/TILE_SIZE;
+  if(!(gx >= 0 && gy >= 0))
+    return false;
+
+  unsigned int tx = static_cast<unsigned int>(gx);
+  unsigned int ty = static_cast<unsigned int>(gy);
+  if(tx >= nx || ty >= ny)
+    return false;
+
+  const Tile& tile = tiles[ty*nx + tx];
+
+  float u = (gx - tx)*tile.res;
+  float v = (gy - ty)*tile.res;
+  unsigned int i = static_cast<unsigned int>(u);
+  unsigned int j = static_cast<unsigned int>(v);
+  if(i >= tile.res)
+    i = tile.res - 1;
+  if(j >= tile.res)
+    j = tile.res - 1;
+  u -= i;
+  v -= j;
+
+  const unsigned int row = tile.res + 1;
+  const float *s00 = &samples[tile.offset + 2*(j*row + i)];
+  const float *s10 = s00 + 2;
+  const float *s01 = s00 + 2*row;
+  const float *s11 = s01 + 2;
+
+  float w00 = (1-u)*(1-v), w10 = u*(1-v), w01 = (1-u)*v, w11 = u*v;
+  fx = w00*s00[0] + w10*s10[0] + w01*s01[0] + w11*s11[0];
+  fy = w00*s00[1] + w10*s10[1] + w01*s01[1] + w11*s11[1];
+
+  const float *b = near_bodies.data() + 3*tile.first_body;
+  for(unsigned int k=0; k<tile.n_bodies; ++k, b+=3)
+  {
+    float dx = x - b[0], dy = y - b[1];
+    float r2 = dx*dx + dy*dy;
+    float inv = 1/sqrt(r2);
+    float w = b[2]*inv*inv*inv;
+
+    fx += w*dx;
+    fy += w*dy;
+  }
+
+  for(unsigned int k=0; k<tile.n_plates; ++k)
+    plate_field_fast(near_plates[tile.first_plate + k], x, y, fx, fy);
+
+  return true;
+}
+
+}
@@ -0,0 +1,73 @@
+// -*- C++ -*-
+/*
+ * SplitFieldGrid.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _SPLIT_FIELD_GRID_H_
+#define _SPLIT_FIELD_GRID_H_
+
+#include <vector>
+
+#include "FieldKernel.h"
+
+namespace Elfelli
+{
+
+/* Field of a fixed set of bodies and plates over a rectangle.  Unlike
+   FieldGrid it has no holes: every square tile keeps the sources
+   within the near radius of it and evaluates them directly, and only
+   samples the field of all the others, which is smooth there.  A
+   sample then costs a few near sources instead of all of them. */
+class SplitFieldGrid
+{
+public:
+  SplitFieldGrid();
+
+  void build(float left, float top, float right, float bottom,
+             const BodyArrays& bodies, const std::vector<PlateFrame>& plates,
+             float near_radius, unsigned int threads);
+  void clear();
+  bool empty() const{return tiles.empty();};
+
+  /* The field a unit charge feels; false outside the rectangle. */
+  bool sample(float x, float y, float& fx, float& fy) const;
+
+  unsigned int n_samples() const{return samples.size()/2;};
+
+  static const float TILE_SIZE;
+
+private:
+  struct Tile
+  {
+    unsigned int offset;       // first sample
+    unsigned int res;          // cells per tile edge
+    unsigned int first_body, n_bodies;    // in `near_bodies'
+    unsigned int first_plate, n_plates;   // in `near_plates'
+  };
+
+  float x0, y0;
+  unsigned int nx, ny;
+  std::vector<Tile> tiles;
+  std::vector<float> samples;
+  std::vector<float> near_bodies;       // x, y and charge of each
+  std::vector<PlateFrame> near_plates;
+};
+
+}
+
+#endif // _SPLIT_FIELD_GRID_H_
@@ -0,0 +1,83 @@
+/*
+ * VisitedCells.cpp
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "VisitedCells.h"
+
+#include <string.h>
+#include <math.h>
+
+namespace Elfelli
+{
+
+const float VisitedCells::CELL(8);
+
+VisitedCells::VisitedCells()
+{
+  clear();
+}
+
+void VisitedCells::clear()
+{
+  memset(keys, 0, sizeof(keys));
+  used = 0;
+  last = 0;
+}
+
+bool VisitedCells::visit(float x, float y, float dx, float dy)
+{
+  /* One of eight 45 degree sectors, without any trigonometry */
+  unsigned int heading = (dx < 0)*4 + (dy < 0)*2 + (fabs(dx) < fabs(dy));
+
+  unsigned int cx = static_cast<unsigned int>(static_cast<int>(floor(x/CELL)));
+  unsigned int cy = static_cast<unsigned int>(static_cast<int>(floor(y/CELL)));
+  /* The cell coordinates themselves rather than a hash of them, so
+     that no two cells within 16384 of each other share a key; 0 is
+     never a key. */
+  unsigned int cell = ((cx & 0x3fff) << 18) | ((cy & 0x3fff) << 4) | 1;
+  unsigned int key = cell | (heading << 1);
+
+  /* Still in the same cell.  The heading is not compared here: on a
+     line right along the edge of a sector it flips from step to step,
+     and would make short steps look like they come back. */
+  if(cell == last)
+    return false;
+  last = cell;
+
+  unsigned int i = (key*2654435761u) >> 23;   // SIZE is 2^9
+  while(keys[i])
+    {
+      if(keys[i] == key)
+        return true;
+      i = (i + 1) & (SIZE - 1);
+    }
+
+  /* A full table would only slow down the probing; a loop is caught
+     again within its next round anyway. */
+  if(used >= SIZE*3/4)
+    {
+      clear();
+      last = cell;
+      i = (key*2654435761u) >> 23;
+    }
+  keys[i] = key;
+  used++;
+  return false;
+}
+
+}
@@ -0,0 +1,55 @@
+// -*- C++ -*-
+/*
+ * VisitedCells.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _VISITED_CELLS_H_
+#define _VISITED_CELLS_H_
+
+namespace Elfelli
+{
+
+/* The coarse cells a single line went through, each together with the
+   rough direction it was heading in.  A field line never comes back to
+   where it was going the same way, so a line that does is caught in a
+   loop of the integration.  Kept in a small fixed hash table, so
+   tracing a line allocates nothing. */
+class VisitedCells
+{
+public:
+  VisitedCells();
+
+  void clear();
+
+  /* Notes that the line is at (x, y) heading along (dx, dy).  Returns
+     true if it entered this cell with the same heading before. */
+  bool visit(float x, float y, float dx, float dy);
+
+  static const float CELL;
+
+private:
+  static const unsigned int SIZE = 512;
+
+  unsigned int keys[SIZE];   // 0 marks a free slot
+  unsigned int used;
+  unsigned int last;         // cell of the last visit
+};
+
+}
+
+#endif // _VISITED_CELLS_H_
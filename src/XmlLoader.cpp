@@ -55,7 +55,7 @@ XmlLoader::~XmlLoader()
 
 int XmlLoader::load(const char *filename, Simulation *target)
 {
-  const int MAX_FILE_SIZE = 100*1024;
+  const int CHUNK_SIZE = 64*1024;
 
   XML_ParserReset(parser, NULL);
   XML_SetUserData(parser, this);
@@ -66,15 +66,24 @@ int XmlLoader::load(const char *filename, Simulation *target)
   errors = 0;
   scene_started = false;
 
-  void *buf = XML_GetBuffer(parser, MAX_FILE_SIZE);
   std::ifstream in(filename);
   if(!in)
     return 1;
-  in.read(reinterpret_cast<char *>(buf), MAX_FILE_SIZE);
-  in.close();
 
+  /* In chunks, so that scenes with thousands of objects are read
+     completely. */
   XML_SetStartElementHandler(parser, XmlLoader::start_element);
-  XML_ParseBuffer(parser, std::strlen(reinterpret_cast<char *>(buf)), 1);
+  bool last = false;
+  while(!last)
+  {
+    void *buf = XML_GetBuffer(parser, CHUNK_SIZE);
+    in.read(reinterpret_cast<char *>(buf), CHUNK_SIZE);
+    int length = in.gcount();
+    last = !in;
+    if(XML_ParseBuffer(parser, length, last) == XML_STATUS_ERROR)
+      break;
+  }
+  in.close();
 
   if(!scene_started)
     return 1;
@@ -91,7 +100,7 @@ void XmlLoader::start_element(void *data, const XML_Char *name, const XML_Char *
     if(strcmp(name, "point") == 0)
     {
       bool have_x, have_y, have_charge;
-      float x, y, charge;
+      float x = 0, y = 0, charge = 0;
 
       have_x=have_y=have_charge=false;
 
@@ -138,7 +147,7 @@ void XmlLoader::start_element(void *data, const XML_Char *name, const XML_Char *
     else if(strcmp(name, "plate") == 0)
     {
       bool have_x1, have_y1, have_x2, have_y2, have_charge;
-      float x1, y1, x2, y2, charge;
+      float x1 = 0, y1 = 0, x2 = 0, y2 = 0, charge = 0;
 
       have_x1=have_y1=have_x2=have_y2=have_charge=false;
 